@@ -2,6 +2,8 @@
 
 #include <QPainter>
 
+#include "CameraProjection.h"
+
 Camera::Camera(const QVector3D& eye,
                const QVector3D& at,
                const QVector3D& up,
@@ -220,26 +222,41 @@ QImage Camera::render(
 	QImage image(width, height, QImage::Format_ARGB32);
 	image.fill(Qt::white);
 
-	QPainter painter(&image);
-	for (const auto& f : faces)
+	// Transform vertices to world coordinates
+	std::vector<float> verticesX(vertices.size());
+	std::vector<float> verticesY(vertices.size());
+	std::vector<float> verticesZ(vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); i++)
 	{
-		const auto v1 = vertices[std::get<0>(f)];
-		const auto v2 = vertices[std::get<1>(f)];
-		const auto v3 = vertices[std::get<2>(f)];
+		const auto vertex = worldMatrix.map(vertices[i]);
+		verticesX[i] = vertex.x();
+		verticesY[i] = vertex.y();
+		verticesZ[i] = vertex.z();
+	}
 
-		// Transform to world coordinates
-		const auto vw1 = worldMatrix.map(v1);
-		const auto vw2 = worldMatrix.map(v2);
-		const auto vw3 = worldMatrix.map(v3);
+	// Project each vertex only once, even if it is shared by several faces
+	std::vector<float> projectedX(vertices.size());
+	std::vector<float> projectedY(vertices.size());
+	const CameraProjection projection(*this, float(width), float(height));
+	projection.project(verticesX.data(),
+	                   verticesY.data(),
+	                   verticesZ.data(),
+	                   int(vertices.size()),
+	                   projectedX.data(),
+	                   projectedY.data());
 
-		// Transform vertices
-		const auto projectedVertex1 = project(vw1, width, height);
-		const auto projectedVertex2 = project(vw2, width, height);
-		const auto projectedVertex3 = project(vw3, width, height);
+	QPainter painter(&image);
+	for (const auto& f : faces)
+	{
+		const auto i1 = std::get<0>(f);
+		const auto i2 = std::get<1>(f);
+		const auto i3 = std::get<2>(f);
 
 		// Draw a 2D triangle
 		QPolygon polygon;
-		polygon << projectedVertex1.toPoint() << projectedVertex2.toPoint() << projectedVertex3.toPoint();
+		polygon << QVector2D(projectedX[i1], projectedY[i1]).toPoint()
+		        << QVector2D(projectedX[i2], projectedY[i2]).toPoint()
+		        << QVector2D(projectedX[i3], projectedY[i3]).toPoint();
 		painter.setBrush(Qt::black);
 		painter.drawPolygon(polygon);
 	}
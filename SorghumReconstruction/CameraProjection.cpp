@@ -0,0 +1,296 @@
+#include "CameraProjection.h"
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+// Multiplications and additions must not be fused, so that results are the same as the scalar version
+#define TARGET_AVX2 __attribute__((target("avx2"), optimize("fp-contract=off")))
+#define TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#endif
+
+namespace
+{
+	/**
+	 * \brief Project one point, the order of operations is the same as in Camera::project
+	 */
+	void projectPoint(const CameraProjection::Coefficients& c, float pointX, float pointY, float pointZ, float& pixelX, float& pixelY)
+	{
+		const auto x = pointX * c.matrix[0][0] + pointY * c.matrix[0][1] + pointZ * c.matrix[0][2] + c.matrix[0][3];
+		const auto y = pointX * c.matrix[1][0] + pointY * c.matrix[1][1] + pointZ * c.matrix[1][2] + c.matrix[1][3];
+		const auto z = pointX * c.matrix[2][0] + pointY * c.matrix[2][1] + pointZ * c.matrix[2][2] + c.matrix[2][3];
+		const auto w = pointX * c.matrix[3][0] + pointY * c.matrix[3][1] + pointZ * c.matrix[3][2] + c.matrix[3][3];
+
+		// Point in Normalized Device Coordinates
+		const auto clipX = x / w;
+		const auto clipY = y / w;
+		const auto clipZ = z / w;
+
+		// Check that the point is in the frustum
+		if (clipX >= -1.0f && clipX <= 1.0f
+		 && clipY >= -1.0f && clipY <= 1.0f
+		 && clipZ >= 0.0f)
+		{
+			// Point in viewport coordinates, with an inverted Y axis
+			pixelX = clipX * c.halfWidth + c.halfWidth;
+			pixelY = c.height - (clipY * c.halfHeight + c.halfHeight);
+		}
+		else
+		{
+			// By default the point has negative coordinates
+			pixelX = -1.0f;
+			pixelY = -1.0f;
+		}
+	}
+
+	/**
+	 * \brief Kernels project points by batches and return the number of projected points
+	 *        Remaining points are projected one by one
+	 */
+	int projectScalar(const CameraProjection::Coefficients& c,
+	                  const float* pointsX,
+	                  const float* pointsY,
+	                  const float* pointsZ,
+	                  int count,
+	                  float* pixelsX,
+	                  float* pixelsY)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			projectPoint(c, pointsX[i], pointsY[i], pointsZ[i], pixelsX[i], pixelsY[i]);
+		}
+
+		return count;
+	}
+
+	TARGET_AVX2
+	int projectAvx2(const CameraProjection::Coefficients& c,
+	                const float* pointsX,
+	                const float* pointsY,
+	                const float* pointsZ,
+	                int count,
+	                float* pixelsX,
+	                float* pixelsY)
+	{
+		__m256 m[4][4];
+		for (int row = 0; row < 4; row++)
+		{
+			for (int col = 0; col < 4; col++)
+			{
+				m[row][col] = _mm256_set1_ps(c.matrix[row][col]);
+			}
+		}
+
+		const auto minusOne = _mm256_set1_ps(-1.0f);
+		const auto one = _mm256_set1_ps(1.0f);
+		const auto zero = _mm256_setzero_ps();
+		const auto halfWidth = _mm256_set1_ps(c.halfWidth);
+		const auto halfHeight = _mm256_set1_ps(c.halfHeight);
+		const auto height = _mm256_set1_ps(c.height);
+
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto px = _mm256_loadu_ps(pointsX + i);
+			const auto py = _mm256_loadu_ps(pointsY + i);
+			const auto pz = _mm256_loadu_ps(pointsZ + i);
+
+			__m256 v[4];
+			for (int row = 0; row < 4; row++)
+			{
+				v[row] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, m[row][0]),
+				                                                   _mm256_mul_ps(py, m[row][1])),
+				                                     _mm256_mul_ps(pz, m[row][2])),
+				                       m[row][3]);
+			}
+
+			const auto clipX = _mm256_div_ps(v[0], v[3]);
+			const auto clipY = _mm256_div_ps(v[1], v[3]);
+			const auto clipZ = _mm256_div_ps(v[2], v[3]);
+
+			// Ordered comparisons are false for NaN, as in the scalar version
+			auto inside = _mm256_and_ps(_mm256_cmp_ps(clipX, minusOne, _CMP_GE_OQ), _mm256_cmp_ps(clipX, one, _CMP_LE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(clipY, minusOne, _CMP_GE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(clipY, one, _CMP_LE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(clipZ, zero, _CMP_GE_OQ));
+
+			const auto x = _mm256_add_ps(_mm256_mul_ps(clipX, halfWidth), halfWidth);
+			const auto y = _mm256_sub_ps(height, _mm256_add_ps(_mm256_mul_ps(clipY, halfHeight), halfHeight));
+
+			_mm256_storeu_ps(pixelsX + i, _mm256_blendv_ps(minusOne, x, inside));
+			_mm256_storeu_ps(pixelsY + i, _mm256_blendv_ps(minusOne, y, inside));
+		}
+
+		return i;
+	}
+
+	TARGET_AVX512
+	int projectAvx512(const CameraProjection::Coefficients& c,
+	                  const float* pointsX,
+	                  const float* pointsY,
+	                  const float* pointsZ,
+	                  int count,
+	                  float* pixelsX,
+	                  float* pixelsY)
+	{
+		__m512 m[4][4];
+		for (int row = 0; row < 4; row++)
+		{
+			for (int col = 0; col < 4; col++)
+			{
+				m[row][col] = _mm512_set1_ps(c.matrix[row][col]);
+			}
+		}
+
+		const auto minusOne = _mm512_set1_ps(-1.0f);
+		const auto one = _mm512_set1_ps(1.0f);
+		const auto zero = _mm512_setzero_ps();
+		const auto halfWidth = _mm512_set1_ps(c.halfWidth);
+		const auto halfHeight = _mm512_set1_ps(c.halfHeight);
+		const auto height = _mm512_set1_ps(c.height);
+
+		int i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const auto px = _mm512_loadu_ps(pointsX + i);
+			const auto py = _mm512_loadu_ps(pointsY + i);
+			const auto pz = _mm512_loadu_ps(pointsZ + i);
+
+			__m512 v[4];
+			for (int row = 0; row < 4; row++)
+			{
+				v[row] = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(px, m[row][0]),
+				                                                   _mm512_mul_ps(py, m[row][1])),
+				                                     _mm512_mul_ps(pz, m[row][2])),
+				                       m[row][3]);
+			}
+
+			const auto clipX = _mm512_div_ps(v[0], v[3]);
+			const auto clipY = _mm512_div_ps(v[1], v[3]);
+			const auto clipZ = _mm512_div_ps(v[2], v[3]);
+
+			// Ordered comparisons are false for NaN, as in the scalar version
+			auto inside = _mm512_cmp_ps_mask(clipX, minusOne, _CMP_GE_OQ);
+			inside &= _mm512_cmp_ps_mask(clipX, one, _CMP_LE_OQ);
+			inside &= _mm512_cmp_ps_mask(clipY, minusOne, _CMP_GE_OQ);
+			inside &= _mm512_cmp_ps_mask(clipY, one, _CMP_LE_OQ);
+			inside &= _mm512_cmp_ps_mask(clipZ, zero, _CMP_GE_OQ);
+
+			const auto x = _mm512_add_ps(_mm512_mul_ps(clipX, halfWidth), halfWidth);
+			const auto y = _mm512_sub_ps(height, _mm512_add_ps(_mm512_mul_ps(clipY, halfHeight), halfHeight));
+
+			_mm512_storeu_ps(pixelsX + i, _mm512_mask_blend_ps(inside, minusOne, x));
+			_mm512_storeu_ps(pixelsY + i, _mm512_mask_blend_ps(inside, minusOne, y));
+		}
+
+		return i;
+	}
+
+	using ProjectionKernel = int(*)(const CameraProjection::Coefficients&,
+	                                const float*, const float*, const float*,
+	                                int,
+	                                float*, float*);
+
+	/**
+	 * \brief Select the widest projection kernel supported by the CPU and the OS
+	 */
+	ProjectionKernel selectProjectionKernel()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		const auto maximumLeaf = info[0];
+
+		__cpuid(info, 1);
+		const auto osxsave = (info[2] & (1 << 27)) != 0;
+		const auto avx = (info[2] & (1 << 28)) != 0;
+
+		if (maximumLeaf < 7 || !osxsave || !avx)
+		{
+			return projectScalar;
+		}
+
+		// The OS must save YMM (and ZMM) registers on context switches
+		const auto xcr0 = _xgetbv(0);
+		const auto ymmEnabled = (xcr0 & 0x06) == 0x06;
+		const auto zmmEnabled = (xcr0 & 0xe6) == 0xe6;
+
+		__cpuidex(info, 7, 0);
+		const auto avx2 = (info[1] & (1 << 5)) != 0;
+		const auto avx512 = (info[1] & (1 << 16)) != 0;
+#else
+		const auto ymmEnabled = true;
+		const auto zmmEnabled = true;
+		const auto avx2 = __builtin_cpu_supports("avx2") != 0;
+		const auto avx512 = __builtin_cpu_supports("avx512f") != 0;
+#endif
+
+		if (avx512 && zmmEnabled)
+		{
+			return projectAvx512;
+		}
+
+		if (avx2 && ymmEnabled)
+		{
+			return projectAvx2;
+		}
+
+		return projectScalar;
+	}
+}
+
+CameraProjection::CameraProjection() :
+	m_coefficients()
+{
+
+}
+
+CameraProjection::CameraProjection(const Camera& camera, float viewportWidth, float viewportHeight) :
+	m_coefficients()
+{
+	const auto transformationMatrix = camera.projectionMatrix() * camera.viewMatrix();
+
+	for (int row = 0; row < 4; row++)
+	{
+		for (int col = 0; col < 4; col++)
+		{
+			m_coefficients.matrix[row][col] = transformationMatrix(row, col);
+		}
+	}
+
+	// Viewport transform from (0, 0) to (viewportWidth, viewportHeight)
+	m_coefficients.halfWidth = viewportWidth / 2.0f;
+	m_coefficients.halfHeight = viewportHeight / 2.0f;
+	m_coefficients.height = viewportHeight;
+}
+
+QVector2D CameraProjection::project(const QVector3D& point) const
+{
+	float pixelX;
+	float pixelY;
+	projectPoint(m_coefficients, point.x(), point.y(), point.z(), pixelX, pixelY);
+
+	return { pixelX, pixelY };
+}
+
+void CameraProjection::project(const float* pointsX,
+                               const float* pointsY,
+                               const float* pointsZ,
+                               int count,
+                               float* pixelsX,
+                               float* pixelsY) const
+{
+	static const auto kernel = selectProjectionKernel();
+
+	const auto projected = kernel(m_coefficients, pointsX, pointsY, pointsZ, count, pixelsX, pixelsY);
+
+	// Project the remaining points outside of the SIMD kernel
+	// to avoid mixing SSE and AVX instructions on short runs
+	for (int i = projected; i < count; i++)
+	{
+		projectPoint(m_coefficients, pointsX[i], pointsY[i], pointsZ[i], pixelsX[i], pixelsY[i]);
+	}
+}
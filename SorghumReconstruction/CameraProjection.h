@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QVector2D>
+#include <QVector3D>
+
+#include "Camera.h"
+
+/**
+ * \brief The projection of a camera on a viewport, precomputed to project many points
+ *        Gives the same results as Camera::project without rebuilding matrices for each point
+ */
+class CameraProjection
+{
+public:
+	CameraProjection();
+
+	/**
+	 * \brief Precompute the projection of a camera
+	 * \param camera The camera
+	 * \param viewportWidth Width of the viewport
+	 * \param viewportHeight Height of the viewport
+	 */
+	CameraProjection(const Camera& camera, float viewportWidth, float viewportHeight);
+
+	/**
+	 * \brief Project a point on the viewport
+	 * \param point A point in world space
+	 * \return The coordinates of the point in the viewport, (-1, -1) if the point is outside the frustum
+	 */
+	QVector2D project(const QVector3D& point) const;
+
+	/**
+	 * \brief Project points on the viewport
+	 *        Points are given as separate arrays of coordinates, they are projected with SIMD instructions if available
+	 *        Points outside the frustum are projected on (-1, -1)
+	 * \param pointsX X coordinates of the points in world space
+	 * \param pointsY Y coordinates of the points in world space
+	 * \param pointsZ Z coordinates of the points in world space
+	 * \param count Number of points
+	 * \param pixelsX Output the X coordinates of the points in the viewport
+	 * \param pixelsY Output the Y coordinates of the points in the viewport
+	 */
+	void project(const float* pointsX,
+	             const float* pointsY,
+	             const float* pointsZ,
+	             int count,
+	             float* pixelsX,
+	             float* pixelsY) const;
+
+	/**
+	 * \brief Coefficients of the projection
+	 *        Rows of the projection * view matrix, followed by the viewport transform
+	 */
+	struct Coefficients
+	{
+		float matrix[4][4];
+		float halfWidth;
+		float halfHeight;
+		float height;
+	};
+
+private:
+	Coefficients m_coefficients;
+};
@@ -0,0 +1,227 @@
+#include "ConnectedComponents.h"
+
+#include <omp.h>
+
+#include <algorithm>
+
+#include "UnionFind.h"
+
+namespace
+{
+	/**
+	 * \brief Unite the runs of two neighbor columns that are 26-connected
+	 */
+	void uniteColumns(const RunLengthVoxelGrid& runs, UnionFind& unionFind, int x, int y, int neighborX, int neighborY)
+	{
+		if (neighborX < 0 || neighborY < 0 || neighborX >= runs.resolutionX() || neighborY >= runs.resolutionY())
+		{
+			return;
+		}
+
+		const auto first = runs.columnBegin(0, 0);
+
+		auto a = runs.columnBegin(x, y);
+		auto b = runs.columnBegin(neighborX, neighborY);
+		const auto endA = runs.columnEnd(x, y);
+		const auto endB = runs.columnEnd(neighborX, neighborY);
+
+		while (a != endA && b != endB)
+		{
+			// Runs touching by a corner along the Z axis are connected
+			if (a->start <= b->end && b->start <= a->end)
+			{
+				unionFind.unionNodes(unsigned(a - first), unsigned(b - first));
+			}
+
+			if (a->end < b->end)
+			{
+				++a;
+			}
+			else
+			{
+				++b;
+			}
+		}
+	}
+}
+
+ConnectedComponents::ConnectedComponents(const VoxelGrid& grid) :
+	m_storage(grid.storage()),
+	m_runs(grid)
+{
+	const auto numberRuns = m_runs.numberRuns();
+
+	UnionFind unionFind(static_cast<unsigned int>(numberRuns));
+
+	// Each thread labels a slab of the X axis, so that most unions are between runs of the same thread
+	const int numberSlabs = omp_get_max_threads();
+
+	#pragma omp parallel for
+	for (int slab = 0; slab < numberSlabs; slab++)
+	{
+		const auto startX = m_runs.resolutionX() * slab / numberSlabs;
+		const auto endX = m_runs.resolutionX() * (slab + 1) / numberSlabs;
+
+		for (int x = startX; x < endX; x++)
+		{
+			for (int y = 0; y < m_runs.resolutionY(); y++)
+			{
+				uniteColumns(m_runs, unionFind, x, y, x, y - 1);
+
+				if (x > startX)
+				{
+					for (int j = -1; j <= 1; j++)
+					{
+						uniteColumns(m_runs, unionFind, x, y, x - 1, y + j);
+					}
+				}
+			}
+		}
+	}
+
+	// Merge equivalences on the boundaries of the slabs, the union-find is shared by all threads
+	for (int slab = 1; slab < numberSlabs; slab++)
+	{
+		const auto x = m_runs.resolutionX() * slab / numberSlabs;
+
+		if (x == 0)
+		{
+			continue;
+		}
+
+		#pragma omp parallel for
+		for (int y = 0; y < m_runs.resolutionY(); y++)
+		{
+			for (int j = -1; j <= 1; j++)
+			{
+				uniteColumns(m_runs, unionFind, x, y, x - 1, y + j);
+			}
+		}
+	}
+
+	// Roots of all runs
+	std::vector<unsigned int> roots(numberRuns);
+
+	#pragma omp parallel for
+	for (int i = 0; i < int(numberRuns); i++)
+	{
+		roots[i] = unionFind.findNode(unsigned(i));
+	}
+
+	// Number components in the order of their first run, and compute their size and bounding box
+	std::vector<int> rootLabels(numberRuns, -1);
+	m_runLabels.resize(numberRuns);
+
+	const auto first = m_runs.columnBegin(0, 0);
+
+	for (int x = 0; x < m_runs.resolutionX(); x++)
+	{
+		for (int y = 0; y < m_runs.resolutionY(); y++)
+		{
+			for (auto run = m_runs.columnBegin(x, y); run != m_runs.columnEnd(x, y); ++run)
+			{
+				const auto root = roots[run - first];
+
+				if (rootLabels[root] < 0)
+				{
+					rootLabels[root] = int(m_components.size());
+					m_components.push_back({ 0, Voxel(x, y, run->start), Voxel(x, y, run->end - 1) });
+				}
+
+				const auto label = rootLabels[root];
+				auto& component = m_components[label];
+
+				component.numberVoxels += run->end - run->start;
+				component.minimum = Voxel(std::min(component.minimum.x, x), std::min(component.minimum.y, y), std::min(component.minimum.z, int(run->start)));
+				component.maximum = Voxel(std::max(component.maximum.x, x), std::max(component.maximum.y, y), std::max(component.maximum.z, run->end - 1));
+
+				m_runLabels[run - first] = label;
+			}
+		}
+	}
+}
+
+int ConnectedComponents::numberComponents() const
+{
+	return int(m_components.size());
+}
+
+const ConnectedComponents::Component& ConnectedComponents::component(int index) const
+{
+	assert(index >= 0 && index < int(m_components.size()));
+
+	return m_components[index];
+}
+
+std::vector<int> ConnectedComponents::voxelLabels() const
+{
+	std::vector<int> labels;
+	labels.reserve(m_runs.numberVoxels());
+
+	// Runs are stored in the order of voxels
+	for (std::size_t i = 0; i < m_runLabels.size(); i++)
+	{
+		const auto& run = m_runs.columnBegin(0, 0)[i];
+
+		labels.insert(labels.end(), run.end - run.start, m_runLabels[i]);
+	}
+
+	return labels;
+}
+
+std::vector<int> ConnectedComponents::largestComponents(int numberComponents) const
+{
+	std::vector<int> components(m_components.size());
+	for (int i = 0; i < int(components.size()); i++)
+	{
+		components[i] = i;
+	}
+
+	// Components of the same size keep the order of their first voxel
+	std::stable_sort(components.begin(), components.end(), [this](int a, int b) {
+		return m_components[a].numberVoxels > m_components[b].numberVoxels;
+	});
+
+	if (int(components.size()) > numberComponents)
+	{
+		components.resize(std::max(numberComponents, 0));
+	}
+
+	return components;
+}
+
+VoxelGrid ConnectedComponents::extractComponents(const std::vector<int>& components) const
+{
+	std::vector<bool> selected(m_components.size(), false);
+	for (const auto component : components)
+	{
+		assert(component >= 0 && component < int(m_components.size()));
+
+		selected[component] = true;
+	}
+
+	VoxelGrid grid(m_runs.boundingBox(), m_runs.resolutionX(), m_runs.resolutionY(), m_runs.resolutionZ(), m_storage);
+
+	const auto first = m_runs.columnBegin(0, 0);
+
+	for (int x = 0; x < m_runs.resolutionX(); x++)
+	{
+		for (int y = 0; y < m_runs.resolutionY(); y++)
+		{
+			for (auto run = m_runs.columnBegin(x, y); run != m_runs.columnEnd(x, y); ++run)
+			{
+				if (selected[m_runLabels[run - first]])
+				{
+					grid.addRange(x, y, run->start, run->end);
+				}
+			}
+		}
+	}
+
+	return grid;
+}
+
+VoxelGrid ConnectedComponents::extractLargestComponents(int numberComponents) const
+{
+	return extractComponents(largestComponents(numberComponents));
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+
+#include "RunLengthVoxelGrid.h"
+#include "VoxelGrid.h"
+
+/**
+ * \brief 26-connected components of the voxels of a grid
+ *        Runs of voxels along the Z axis are labeled in parallel on slabs of the X axis,
+ *        equivalences on the boundaries of the slabs are merged afterwards
+ */
+class ConnectedComponents
+{
+public:
+	/**
+	 * \brief Size and bounding box of a connected component
+	 */
+	struct Component
+	{
+		std::size_t numberVoxels;
+		Voxel minimum;
+		Voxel maximum;
+	};
+
+	/**
+	 * \brief Label the connected components of a voxel grid
+	 * \param grid A voxel grid
+	 */
+	explicit ConnectedComponents(const VoxelGrid& grid);
+
+	/**
+	 * \brief Return the number of connected components
+	 * \return The number of connected components
+	 */
+	int numberComponents() const;
+
+	/**
+	 * \brief Return a connected component, components are numbered in the order of their first voxel
+	 * \param index Index of the component
+	 * \return The component
+	 */
+	const Component& component(int index) const;
+
+	/**
+	 * \brief Return the label of each voxel
+	 * \return The index of the component of each voxel, in the order of grid.voxels()
+	 */
+	std::vector<int> voxelLabels() const;
+
+	/**
+	 * \brief Return the largest connected components, by decreasing number of voxels
+	 * \param numberComponents Maximum number of components to return
+	 * \return Indices of the largest components
+	 */
+	std::vector<int> largestComponents(int numberComponents) const;
+
+	/**
+	 * \brief Return a voxel grid with the voxels of some connected components
+	 * \param components Indices of the components
+	 * \return A voxel grid with the same resolution and storage as the labeled grid
+	 */
+	VoxelGrid extractComponents(const std::vector<int>& components) const;
+
+	/**
+	 * \brief Return a voxel grid with the voxels of the largest connected components
+	 * \param numberComponents Maximum number of components to extract
+	 * \return A voxel grid with the same resolution and storage as the labeled grid
+	 */
+	VoxelGrid extractLargestComponents(int numberComponents) const;
+
+private:
+	/**
+	 * \brief Storage of the labeled grid
+	 */
+	VoxelStorage m_storage;
+
+	/**
+	 * \brief Runs of voxels of the labeled grid
+	 */
+	RunLengthVoxelGrid m_runs;
+
+	/**
+	 * \brief Index of the component of each run
+	 */
+	std::vector<int> m_runLabels;
+
+	/**
+	 * \brief Size and bounding box of each component
+	 */
+	std::vector<Component> m_components;
+};
@@ -227,7 +227,7 @@ bool ConsoleApplication::runReconstruction()
 	const auto cameras = generateCameras(availableAngles, 90.f);
 	
 	// 3D reconstruction
-	VoxelCarver carver(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
+	VoxelCarver carver(m_objectBoundingBox, m_resolution, m_resolution, m_resolution, m_parameters.storage);
 	
 	carver.clearCameras();
 	for (unsigned int i = 0; i < cameraImages.size(); i++)
@@ -240,6 +240,15 @@ bool ConsoleApplication::runReconstruction()
 		carver.voxelGrid().voxelSizeZ() / 4.0f
 	}));
 
+	// Reuse the projections computed for previous plants, only column interval carving uses them
+	if (!m_parameters.projectionCacheDirectory.isEmpty())
+	{
+		qInfo() << "Projection cache enabled, carving voxels by column intervals";
+
+		carver.setProjectionCacheDirectory(m_parameters.projectionCacheDirectory);
+		carver.setCarvingMode(CarvingMode::ColumnInterval);
+	}
+
 	// Process the voxel grid and save it
 	carver.process();
 	// Extract the major connected component if needed
@@ -278,7 +287,7 @@ bool ConsoleApplication::runReconstruction()
 
 bool ConsoleApplication::runDensity()
 {
-	VoxelGrid grid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
+	VoxelGrid grid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution, m_parameters.storage);
 	grid.importVoxels(m_parameters.inputFile.toStdString());
 
 	const auto volume = boundingCylinderVolume(grid);
@@ -291,7 +300,7 @@ bool ConsoleApplication::runDensity()
 
 bool ConsoleApplication::runDirectionality()
 {
-	VoxelGrid grid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
+	VoxelGrid grid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution, m_parameters.storage);
 	grid.importVoxels(m_parameters.inputFile.toStdString());
 
 	const auto directionality = computeDirectionality(grid);
@@ -304,7 +313,7 @@ bool ConsoleApplication::runDirectionality()
 
 bool ConsoleApplication::runSurface()
 {
-	VoxelGrid grid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
+	VoxelGrid grid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution, m_parameters.storage);
 	grid.importVoxels(m_parameters.inputFile.toStdString());
 
 	const auto numberVoxels = countNumberSurfaceVoxels(grid);
@@ -317,7 +326,7 @@ bool ConsoleApplication::runSurface()
 
 bool ConsoleApplication::runHeight()
 {
-	VoxelGrid grid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
+	VoxelGrid grid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution, m_parameters.storage);
 	grid.importVoxels(m_parameters.inputFile.toStdString());
 
 	float topVoxelAltitude = 0.0f;
@@ -362,10 +371,10 @@ bool ConsoleApplication::processSkeleton()
 	SvmRbfSkeletonBranchClassifier classifier;
 	classifier.load("model.yml");
 
-	VoxelGrid carvingGrid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
+	VoxelGrid carvingGrid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution, m_parameters.storage);
 	carvingGrid.importVoxels(inputDir.filePath(voxelFilename).toStdString());
 	
-	VoxelGrid skeletonGrid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
+	VoxelGrid skeletonGrid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution, m_parameters.storage);
 	skeletonGrid.importVoxels(inputDir.filePath(skeletonFilename).toStdString());
 
 	if (skeletonGrid.empty())
@@ -376,8 +385,6 @@ bool ConsoleApplication::processSkeleton()
 	
 	// Run voxel skeleton optimization
 	// Find endpoints in the skeleton
-	// Sorting voxels is mandatory to accelerate algorithms
-	skeletonGrid.sortVoxels();
 	auto endpoints = extractSkeletonEndpoints(skeletonGrid);
 
 	// Find the lowest endpoint, which is most probably the root of the plant
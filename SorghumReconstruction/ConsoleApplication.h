@@ -3,6 +3,7 @@
 #include <QObject>
 
 #include "AABB.h"
+#include "VoxelGrid.h"
 
 enum class CommandType
 {
@@ -25,6 +26,10 @@ struct ConsoleApplicationParameters
 	CommandType commandType;
 	QString inputFile;
 	QString outputFile;
+	// Directory in which projections of the voxel grid are cached between plants, empty to disable
+	QString projectionCacheDirectory;
+	// How voxel grids are stored, sparse storage fits grids of high resolution in memory
+	VoxelStorage storage;
 };
 
 class ConsoleApplication : public QObject
@@ -0,0 +1,311 @@
+#include "DistanceTransform.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <QDebug>
+
+namespace
+{
+	/**
+	 * \brief Buffers used to transform one line of the box
+	 */
+	struct Line
+	{
+		explicit Line(int size) :
+			values(size),
+			seeds(size),
+			sites(size),
+			boundaries(size)
+		{
+
+		}
+
+		// Squared distances and nearest seeds of the line before the transform
+		std::vector<float> values;
+		std::vector<int> seeds;
+
+		// Positions of the parabolas of the lower envelope, and where each one starts
+		std::vector<int> sites;
+		std::vector<double> boundaries;
+	};
+
+	/**
+	 * \brief Transform a line of the box in place: d(i) = min_j d(j) + (spacing * (i - j))^2
+	 *        The lower envelope of the parabolas rooted at each voxel is built, then sampled at each voxel
+	 * \param index Function returning the index in the box of the i-th voxel of the line
+	 */
+	template<typename Index>
+	void transformLine(std::vector<float>& squaredDistances, std::vector<int>& nearestSeeds, int size, double spacing, Index index, Line& line)
+	{
+		const auto infinity = std::numeric_limits<float>::infinity();
+		const auto weight = spacing * spacing;
+		const auto withSeeds = !nearestSeeds.empty();
+
+		for (int i = 0; i < size; i++)
+		{
+			line.values[i] = squaredDistances[index(i)];
+
+			if (withSeeds)
+			{
+				line.seeds[i] = nearestSeeds[index(i)];
+			}
+		}
+
+		// Parabola of q intersects parabola of v at s, voxels without seed have no parabola
+		int k = -1;
+
+		for (int q = 0; q < size; q++)
+		{
+			if (line.values[q] == infinity)
+			{
+				continue;
+			}
+
+			double s = -std::numeric_limits<double>::infinity();
+
+			while (k >= 0)
+			{
+				const auto v = line.sites[k];
+				s = ((line.values[q] + weight * q * q) - (line.values[v] + weight * v * v)) / (2.0 * weight * (q - v));
+
+				// The parabola of v is hidden by the parabolas of q and of the previous site
+				if (s <= line.boundaries[k])
+				{
+					k--;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			k++;
+			line.sites[k] = q;
+			line.boundaries[k] = (k == 0) ? -std::numeric_limits<double>::infinity() : s;
+		}
+
+		if (k < 0)
+		{
+			return;
+		}
+
+		// Among parabolas meeting at a voxel, the one of the first site is kept
+		int j = 0;
+
+		for (int p = 0; p < size; p++)
+		{
+			while (j < k && line.boundaries[j + 1] < p)
+			{
+				j++;
+			}
+
+			const auto v = line.sites[j];
+			const auto offset = double(p - v);
+
+			squaredDistances[index(p)] = float(weight * offset * offset + line.values[v]);
+
+			if (withSeeds)
+			{
+				nearestSeeds[index(p)] = line.seeds[v];
+			}
+		}
+	}
+
+	/**
+	 * \brief Return the distance between the centers of two neighbor voxels along an axis
+	 */
+	double voxelSpacing(float size, int resolution)
+	{
+		return (resolution > 1) ? double(size) / double(resolution - 1) : 1.0;
+	}
+}
+
+DistanceTransform::DistanceTransform(const VoxelGrid& seeds, const VoxelGrid& domain, bool computeNearestSeeds) :
+	m_sizeX(0),
+	m_sizeY(0),
+	m_sizeZ(0)
+{
+	// Voxels of the domain are looked up with the coordinates of the seeds
+	if (!haveSameLayout(seeds, domain))
+	{
+		qWarning() << "The distance transform requires grids with the same resolutions and bounding box";
+		return;
+	}
+
+	// The nearest seed of a voxel of the domain is found inside the box covering both grids
+	Voxel minimum(seeds.resolutionX(), seeds.resolutionY(), seeds.resolutionZ());
+	Voxel maximum(0, 0, 0);
+
+	for (const auto* grid : { &seeds, &domain })
+	{
+		if (grid->empty())
+		{
+			continue;
+		}
+
+		const auto box = grid->voxelBoundingBox();
+
+		minimum = Voxel(std::min(minimum.x, box.first.x), std::min(minimum.y, box.first.y), std::min(minimum.z, box.first.z));
+		maximum = Voxel(std::max(maximum.x, box.second.x), std::max(maximum.y, box.second.y), std::max(maximum.z, box.second.z));
+	}
+
+	if (seeds.empty() && domain.empty())
+	{
+		return;
+	}
+
+	m_minimum = minimum;
+	m_sizeX = maximum.x - minimum.x + 1;
+	m_sizeY = maximum.y - minimum.y + 1;
+	m_sizeZ = maximum.z - minimum.z + 1;
+
+	const auto numberCells = std::size_t(m_sizeX) * std::size_t(m_sizeY) * std::size_t(m_sizeZ);
+
+	m_squaredDistances.assign(numberCells, std::numeric_limits<float>::infinity());
+
+	if (computeNearestSeeds)
+	{
+		m_nearestSeeds.assign(numberCells, -1);
+	}
+
+	const auto& seedVoxels = seeds.voxels();
+
+	#pragma omp parallel for
+	for (int i = 0; i < int(seedVoxels.size()); i++)
+	{
+		const auto cell = cellIndex(seedVoxels[i]);
+
+		m_squaredDistances[cell] = 0.0f;
+
+		if (computeNearestSeeds)
+		{
+			m_nearestSeeds[cell] = i;
+		}
+	}
+
+	const auto& boundingBox = seeds.boundingBox();
+	const auto spacingX = voxelSpacing(boundingBox.sizeX(), seeds.resolutionX());
+	const auto spacingY = voxelSpacing(boundingBox.sizeY(), seeds.resolutionY());
+	const auto spacingZ = voxelSpacing(boundingBox.sizeZ(), seeds.resolutionZ());
+
+	const auto sizeY = std::size_t(m_sizeY);
+	const auto sizeZ = std::size_t(m_sizeZ);
+
+	// Along Z and then Y, each thread transforms the lines of a slab of the X axis
+	#pragma omp parallel for
+	for (int x = 0; x < m_sizeX; x++)
+	{
+		Line line(std::max(m_sizeY, m_sizeZ));
+
+		for (int y = 0; y < m_sizeY; y++)
+		{
+			const auto start = (x * sizeY + y) * sizeZ;
+
+			transformLine(m_squaredDistances, m_nearestSeeds, m_sizeZ, spacingZ, [&](int z) {
+				return start + z;
+			}, line);
+		}
+
+		for (int z = 0; z < m_sizeZ; z++)
+		{
+			const auto start = x * sizeY * sizeZ + z;
+
+			transformLine(m_squaredDistances, m_nearestSeeds, m_sizeY, spacingY, [&](int y) {
+				return start + y * sizeZ;
+			}, line);
+		}
+	}
+
+	// Along X, each thread transforms the lines of a slab of the Y axis
+	#pragma omp parallel for
+	for (int y = 0; y < m_sizeY; y++)
+	{
+		Line line(m_sizeX);
+
+		for (int z = 0; z < m_sizeZ; z++)
+		{
+			const auto start = y * sizeZ + z;
+
+			transformLine(m_squaredDistances, m_nearestSeeds, m_sizeX, spacingX, [&](int x) {
+				return start + x * sizeY * sizeZ;
+			}, line);
+		}
+	}
+}
+
+bool DistanceTransform::haveSameLayout(const VoxelGrid& first, const VoxelGrid& second)
+{
+	const auto& firstBox = first.boundingBox();
+	const auto& secondBox = second.boundingBox();
+
+	return first.resolutionX() == second.resolutionX()
+	    && first.resolutionY() == second.resolutionY()
+	    && first.resolutionZ() == second.resolutionZ()
+	    && firstBox.minX() == secondBox.minX() && firstBox.maxX() == secondBox.maxX()
+	    && firstBox.minY() == secondBox.minY() && firstBox.maxY() == secondBox.maxY()
+	    && firstBox.minZ() == secondBox.minZ() && firstBox.maxZ() == secondBox.maxZ();
+}
+
+bool DistanceTransform::isVoxelInsideTransform(const Voxel& voxel) const
+{
+	return (voxel.x >= m_minimum.x && voxel.x < m_minimum.x + m_sizeX)
+		&& (voxel.y >= m_minimum.y && voxel.y < m_minimum.y + m_sizeY)
+		&& (voxel.z >= m_minimum.z && voxel.z < m_minimum.z + m_sizeZ);
+}
+
+float DistanceTransform::distance(const Voxel& voxel) const
+{
+	assert(isVoxelInsideTransform(voxel));
+
+	return std::sqrt(m_squaredDistances[cellIndex(voxel)]);
+}
+
+int DistanceTransform::nearestSeed(const Voxel& voxel) const
+{
+	assert(isVoxelInsideTransform(voxel));
+	assert(!m_nearestSeeds.empty());
+
+	return m_nearestSeeds[cellIndex(voxel)];
+}
+
+std::vector<float> DistanceTransform::distances(const VoxelGrid& grid) const
+{
+	const auto& voxels = grid.voxels();
+
+	std::vector<float> distances(voxels.size());
+
+	#pragma omp parallel for
+	for (int i = 0; i < int(voxels.size()); i++)
+	{
+		distances[i] = distance(voxels[i]);
+	}
+
+	return distances;
+}
+
+std::vector<int> DistanceTransform::nearestSeeds(const VoxelGrid& grid) const
+{
+	const auto& voxels = grid.voxels();
+
+	std::vector<int> nearestSeeds(voxels.size());
+
+	#pragma omp parallel for
+	for (int i = 0; i < int(voxels.size()); i++)
+	{
+		nearestSeeds[i] = nearestSeed(voxels[i]);
+	}
+
+	return nearestSeeds;
+}
+
+std::size_t DistanceTransform::cellIndex(const Voxel& voxel) const
+{
+	const auto x = std::size_t(voxel.x - m_minimum.x);
+	const auto y = std::size_t(voxel.y - m_minimum.y);
+	const auto z = std::size_t(voxel.z - m_minimum.z);
+
+	return (x * std::size_t(m_sizeY) + y) * std::size_t(m_sizeZ) + z;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+
+#include "VoxelGrid.h"
+
+/**
+ * \brief Exact Euclidean distance from voxels to the nearest voxel of a set of seeds, and optionally the nearest seed
+ *        The transform is separable: lower envelopes of parabolas along Z, Y and then X, each pass in parallel on slabs
+ *        Distances are computed between voxel centers, on the box covering the seeds and the voxels of a domain
+ */
+class DistanceTransform
+{
+public:
+	/**
+	 * \brief Compute the distance transform of a set of seeds
+	 *        If the grids do not share their layout, a warning is issued and the transform is empty
+	 * \param seeds Voxels to which distances are computed
+	 * \param domain Voxels whose distances are requested, with the same layout as the seeds
+	 * \param computeNearestSeeds True to also compute the nearest seed of each voxel
+	 */
+	DistanceTransform(const VoxelGrid& seeds, const VoxelGrid& domain, bool computeNearestSeeds = false);
+
+	/**
+	 * \brief Return true if two grids have the same layout: same resolutions and same bounding box,
+	 *        so that a voxel has the same center in both grids
+	 * \param first A voxel grid
+	 * \param second A voxel grid
+	 * \return True if the transform of one grid gives the distances of the voxels of the other
+	 */
+	static bool haveSameLayout(const VoxelGrid& first, const VoxelGrid& second);
+
+	/**
+	 * \brief Return true if the voxel is inside the box on which the transform is computed
+	 * \param voxel A voxel
+	 * \return True if the voxel is inside the box, always true for the voxels of the seeds and of the domain
+	 */
+	bool isVoxelInsideTransform(const Voxel& voxel) const;
+
+	/**
+	 * \brief Return the distance from a voxel to the nearest seed
+	 * \param voxel A voxel inside the transform
+	 * \return The distance between the centers of the voxel and of the nearest seed, infinity if there is no seed
+	 */
+	float distance(const Voxel& voxel) const;
+
+	/**
+	 * \brief Return the nearest seed of a voxel, the nearest seeds must have been computed
+	 * \param voxel A voxel inside the transform
+	 * \return Index of the nearest seed in seeds.voxels(), -1 if there is no seed
+	 */
+	int nearestSeed(const Voxel& voxel) const;
+
+	/**
+	 * \brief Return the distance from each voxel of a grid to the nearest seed
+	 * \param grid A voxel grid whose voxels are inside the transform, usually the domain
+	 * \return The distance of each voxel, in the order of grid.voxels()
+	 */
+	std::vector<float> distances(const VoxelGrid& grid) const;
+
+	/**
+	 * \brief Return the nearest seed of each voxel of a grid, the nearest seeds must have been computed
+	 * \param grid A voxel grid whose voxels are inside the transform, usually the domain
+	 * \return Index of the nearest seed of each voxel in seeds.voxels(), in the order of grid.voxels()
+	 */
+	std::vector<int> nearestSeeds(const VoxelGrid& grid) const;
+
+private:
+	/**
+	 * \brief Index of a voxel in the box, voxels are ordered by X, Y and then Z
+	 */
+	std::size_t cellIndex(const Voxel& voxel) const;
+
+	/**
+	 * \brief Lowest corner of the box on which the transform is computed
+	 */
+	Voxel m_minimum;
+
+	/**
+	 * \brief Size of the box on the X axis
+	 */
+	int m_sizeX;
+
+	/**
+	 * \brief Size of the box on the Y axis
+	 */
+	int m_sizeY;
+
+	/**
+	 * \brief Size of the box on the Z axis
+	 */
+	int m_sizeZ;
+
+	/**
+	 * \brief Squared distance of each voxel of the box to the nearest seed
+	 */
+	std::vector<float> m_squaredDistances;
+
+	/**
+	 * \brief Index of the nearest seed of each voxel of the box, empty if not computed
+	 */
+	std::vector<int> m_nearestSeeds;
+};
@@ -344,8 +344,6 @@ void MainWindow::processSkeletonAndSetupVoxelGrid()
 	skeletonGrid.importVoxels("E:\\CIS\\skeletons\\" + folder + "\\skeleton.txt");
 
 	// Find endpoints in the skeleton
-	// Sorting voxels is mandatory to accelerate algorithms
-	skeletonGrid.sortVoxels();
 	auto endpoints = extractSkeletonEndpoints(skeletonGrid);
 
 	// Find the lowest endpoint, which is most probably the root of the plant
@@ -464,9 +462,7 @@ void MainWindow::showVoxelizedMesh()
 
 	// Voxelize mesh
 	VoxelGrid meshGrid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
-	voxelizeMesh(meshGrid, meshWorldMatrix, reader.vertices(), reader.faces());
-	fillCavitiesInGrid(meshGrid);
-	meshGrid.sortVoxels();
+	voxelizeSolidMesh(meshGrid, meshWorldMatrix, reader.vertices(), reader.faces());
 	meshGrid = extractMajorConnectedComponent(meshGrid);
 	// meshGrid.saveVoxelsAsOBJ("C:\\Code\\mesh_voxels.obj", false);
 	// meshGrid.exportVoxels("C:\\Code\\mesh_voxels.txt");
@@ -565,9 +561,7 @@ void MainWindow::benchmarkNumberCameras()
 
 		// Generate a reference grid for this mesh
 		VoxelGrid meshGrid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
-		voxelizeMesh(meshGrid, meshWorldMatrix, reader.vertices(), reader.faces());
-		fillCavitiesInGrid(meshGrid);
-		meshGrid.sortVoxels();
+		voxelizeSolidMesh(meshGrid, meshWorldMatrix, reader.vertices(), reader.faces());
 		meshGrid = extractMajorConnectedComponent(meshGrid);
 
 		for (unsigned int c = 0; c < cameraSetups.size(); c++)
@@ -658,9 +652,7 @@ void MainWindow::benchmarkCameraOffset()
 
 		// Generate a reference grid for this mesh
 		VoxelGrid meshGrid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
-		voxelizeMesh(meshGrid, meshWorldMatrix, reader.vertices(), reader.faces());
-		fillCavitiesInGrid(meshGrid);
-		meshGrid.sortVoxels();
+		voxelizeSolidMesh(meshGrid, meshWorldMatrix, reader.vertices(), reader.faces());
 		meshGrid = extractMajorConnectedComponent(meshGrid);
 
 		for (unsigned int o = 0; o < offsets.size(); o++)
@@ -742,9 +734,7 @@ void MainWindow::benchmarkMetrics()
 
 		// Generate a reference grid for this mesh
 		VoxelGrid meshGrid(m_objectBoundingBox, m_resolution, m_resolution, m_resolution);
-		voxelizeMesh(meshGrid, meshWorldMatrix, reader.vertices(), reader.faces());
-		fillCavitiesInGrid(meshGrid);
-		meshGrid.sortVoxels();
+		voxelizeSolidMesh(meshGrid, meshWorldMatrix, reader.vertices(), reader.faces());
 		meshGrid = extractMajorConnectedComponent(meshGrid);
 
 		// Generate uniformly distributed cameras with top camera
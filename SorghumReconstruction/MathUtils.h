@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <bitset>
+#include <cstdint>
 
 #include <QVector3D>
 #include <QMatrix4x4>
@@ -42,6 +44,44 @@ template <typename T> int sign(T val)
 	return (T(0) < val) - (val < T(0));
 }
 
+/**
+ * \brief Return the number of set bits in a word
+ * \param bits A word
+ * \return The number of set bits
+ */
+inline int countBits(std::uint64_t bits)
+{
+	return int(std::bitset<64>(bits).count());
+}
+
+/**
+ * \brief Return the index of the lowest set bit in a word
+ * \param bits A non-zero word
+ * \return The index of the lowest set bit
+ */
+inline int lowestBit(std::uint64_t bits)
+{
+	return countBits((bits & (~bits + 1)) - 1);
+}
+
+/**
+ * \brief Return the index of the highest set bit in a word
+ * \param bits A non-zero word
+ * \return The index of the highest set bit
+ */
+inline int highestBit(std::uint64_t bits)
+{
+	// Set all bits below the highest one
+	bits |= bits >> 1;
+	bits |= bits >> 2;
+	bits |= bits >> 4;
+	bits |= bits >> 8;
+	bits |= bits >> 16;
+	bits |= bits >> 32;
+
+	return countBits(bits) - 1;
+}
+
 template<typename T>
 T cubicInterpolate(const T& p0, const T& p1, const T& p2, const T& p3, double t)
 {
@@ -0,0 +1,137 @@
+#include "ProjectionCache.h"
+
+#include <cstring>
+#include <utility>
+
+#include <QSaveFile>
+
+namespace
+{
+	const char cacheMagic[4] = { 'S', 'V', 'P', 'C' };
+
+	// Increment when the layout of spans or the way they are computed changes
+	const std::uint32_t cacheVersion = 1;
+}
+
+ProjectionCache::ProjectionCache() :
+	m_data(nullptr),
+	m_size(0)
+{
+
+}
+
+std::uint64_t ProjectionCache::computeKey(const std::vector<float>& values)
+{
+	// FNV-1a hash of the bytes of the values
+	std::uint64_t hash = 14695981039346656037ull;
+
+	for (const auto value : values)
+	{
+		unsigned char bytes[sizeof(float)];
+		std::memcpy(bytes, &value, sizeof(float));
+
+		for (const auto byte : bytes)
+		{
+			hash ^= byte;
+			hash *= 1099511628211ull;
+		}
+	}
+
+	return hash;
+}
+
+bool ProjectionCache::load(const QString& fileName, std::uint64_t key, std::size_t numberSpans)
+{
+	if (m_file.isOpen())
+	{
+		m_file.close();
+	}
+
+	m_file.setFileName(fileName);
+	if (!m_file.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+
+	const auto fileSize = m_file.size();
+	if (fileSize < qint64(sizeof(Header)))
+	{
+		m_file.close();
+		return false;
+	}
+
+	const auto data = m_file.map(0, fileSize);
+	if (data == nullptr)
+	{
+		m_file.close();
+		return false;
+	}
+
+	Header header;
+	std::memcpy(&header, data, sizeof(Header));
+
+	// The file has been computed for other cameras or another voxel grid
+	if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0
+	 || header.version != cacheVersion
+	 || header.key != key
+	 || header.numberSpans != numberSpans)
+	{
+		m_file.unmap(data);
+		m_file.close();
+		return false;
+	}
+
+	// The file is truncated or has trailing data, the mapping must hold exactly the spans of the header
+	if (fileSize - qint64(sizeof(Header)) != qint64(header.numberSpans * sizeof(ColumnSpan)))
+	{
+		m_file.unmap(data);
+		m_file.close();
+		return false;
+	}
+
+	m_spans.clear();
+	m_data = reinterpret_cast<const ColumnSpan*>(data + sizeof(Header));
+	m_size = numberSpans;
+
+	return true;
+}
+
+bool ProjectionCache::save(const QString& fileName, std::uint64_t key) const
+{
+	Header header;
+	std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.key = key;
+	header.numberSpans = m_size;
+
+	// The spans are written in a temporary file renamed on commit, so that a concurrent
+	// load never maps a partially written file
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		return false;
+	}
+
+	const auto spansSize = qint64(m_size * sizeof(ColumnSpan));
+
+	if (file.write(reinterpret_cast<const char*>(&header), sizeof(Header)) != qint64(sizeof(Header))
+	 || file.write(reinterpret_cast<const char*>(m_data), spansSize) != spansSize)
+	{
+		file.cancelWriting();
+		return false;
+	}
+
+	return file.commit();
+}
+
+void ProjectionCache::setSpans(std::vector<ColumnSpan> spans)
+{
+	if (m_file.isOpen())
+	{
+		m_file.close();
+	}
+
+	m_spans = std::move(spans);
+	m_data = m_spans.data();
+	m_size = m_spans.size();
+}
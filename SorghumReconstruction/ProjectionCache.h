@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+
+/**
+ * \brief Projections of the Z columns of a voxel grid on cameras, optionally persisted in a memory-mapped file
+ *        Plants imaged with the same cameras and bounding box share the same projections
+ */
+class ProjectionCache
+{
+public:
+	/**
+	 * \brief Projection of a Z column of voxels on a camera whose view is horizontal
+	 */
+	struct ColumnSpan
+	{
+		/**
+		 * \brief Column of pixels on which voxels are projected
+		 */
+		std::int16_t pixelColumn;
+
+		/**
+		 * \brief Size of the neighborhood around the projection of voxels
+		 *        Negative if the column does not project on a single column of pixels
+		 */
+		std::int16_t offset;
+
+		/**
+		 * \brief Row of the pixel of the first voxel of the column
+		 */
+		float bottomRow;
+
+		/**
+		 * \brief Difference between the rows of two consecutive voxels
+		 */
+		float rowStep;
+	};
+
+	ProjectionCache();
+
+	ProjectionCache(const ProjectionCache&) = delete;
+	ProjectionCache& operator=(const ProjectionCache&) = delete;
+
+	/**
+	 * \brief Hash values identifying the cameras, the bounding box and the resolution of the voxel grid
+	 * \param values The values to hash
+	 * \return A 64-bit key
+	 */
+	static std::uint64_t computeKey(const std::vector<float>& values);
+
+	/**
+	 * \brief Memory-map the spans stored in a file
+	 * \param fileName The path to the file
+	 * \param key The key of the expected projections
+	 * \param numberSpans The number of expected spans
+	 * \return True if the file exists, matches the key and holds exactly the spans of its header, false otherwise
+	 */
+	bool load(const QString& fileName, std::uint64_t key, std::size_t numberSpans);
+
+	/**
+	 * \brief Save the spans in a file to reuse them later, the file is replaced at once when complete
+	 * \param fileName The path to the file
+	 * \param key The key of the projections
+	 * \return True if the file has been written, false otherwise
+	 */
+	bool save(const QString& fileName, std::uint64_t key) const;
+
+	/**
+	 * \brief Replace the spans by newly computed ones
+	 * \param spans The spans
+	 */
+	void setSpans(std::vector<ColumnSpan> spans);
+
+	/**
+	 * \brief Return a span
+	 * \param index The index of the span
+	 * \return The span
+	 */
+	const ColumnSpan& span(std::size_t index) const
+	{
+		return m_data[index];
+	}
+
+private:
+	/**
+	 * \brief Header at the beginning of the file
+	 */
+	struct Header
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint64_t key;
+		std::uint64_t numberSpans;
+	};
+
+	/**
+	 * \brief The memory-mapped file, if spans have been loaded
+	 */
+	QFile m_file;
+
+	/**
+	 * \brief The spans, if they have been computed
+	 */
+	std::vector<ColumnSpan> m_spans;
+
+	/**
+	 * \brief Pointer to the spans, either in the file or in memory
+	 */
+	const ColumnSpan* m_data;
+
+	/**
+	 * \brief Number of spans
+	 */
+	std::size_t m_size;
+};
@@ -0,0 +1,436 @@
+#include "RunLengthVoxelGrid.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+#include "MathUtils.h"
+
+namespace
+{
+	using Run = RunLengthVoxelGrid::Run;
+
+	/**
+	 * \brief Intersect sorted runs with the runs of a column shrunk by one voxel at both ends
+	 */
+	void intersectEroded(const std::vector<Run>& runs, const Run* begin, const Run* end, std::vector<Run>& result)
+	{
+		auto a = runs.begin();
+		auto b = begin;
+
+		while (a != runs.end() && b != end)
+		{
+			const auto erodedStart = b->start + 1;
+			const auto erodedEnd = b->end - 1;
+
+			const auto start = std::max(int(a->start), erodedStart);
+			const auto stop = std::min(int(a->end), erodedEnd);
+
+			if (start < stop)
+			{
+				result.emplace_back(start, stop);
+			}
+
+			if (a->end < erodedEnd)
+			{
+				++a;
+			}
+			else
+			{
+				++b;
+			}
+		}
+	}
+}
+
+RunLengthVoxelGrid::RunLengthVoxelGrid(const AABB& boundingBox, int resolutionX, int resolutionY, int resolutionZ) :
+	m_boundingBox(boundingBox),
+	m_resolutionX(resolutionX),
+	m_resolutionY(resolutionY),
+	m_resolutionZ(resolutionZ),
+	m_columnOffsets(std::size_t(resolutionX) * std::size_t(resolutionY) + 1, 0)
+{
+	// Coordinates of runs are stored on 16 bits
+	assert(resolutionZ <= std::numeric_limits<std::uint16_t>::max());
+}
+
+RunLengthVoxelGrid::RunLengthVoxelGrid(const VoxelGrid& grid) :
+	RunLengthVoxelGrid(grid.boundingBox(), grid.resolutionX(), grid.resolutionY(), grid.resolutionZ())
+{
+	buildColumns([&grid](int x, int y, std::vector<Run>& runs) {
+		const auto firstRun = runs.size();
+
+		for (int w = 0; w < grid.wordsPerColumn(); w++)
+		{
+			auto bits = grid.word(w, x, y);
+
+			while (bits != 0)
+			{
+				// The run ends at the first unset bit after its start
+				const auto start = lowestBit(bits);
+				const auto filled = bits | ((std::uint64_t(1) << start) - 1);
+				const auto end = (filled == ~std::uint64_t(0)) ? 64 : lowestBit(~filled);
+
+				// Continue the run of the previous word
+				if (runs.size() > firstRun && runs.back().end == 64 * w + start)
+				{
+					runs.back().end = std::uint16_t(64 * w + end);
+				}
+				else
+				{
+					runs.emplace_back(64 * w + start, 64 * w + end);
+				}
+
+				bits = (end == 64) ? 0 : bits & ~((std::uint64_t(1) << end) - 1);
+			}
+		}
+	});
+}
+
+template<typename AppendColumn>
+void RunLengthVoxelGrid::buildColumns(AppendColumn appendColumn)
+{
+	// Runs of each slab along the X axis, columns of a slab are already in order
+	std::vector<std::vector<Run>> slabRuns(m_resolutionX);
+
+	m_columnOffsets.assign(std::size_t(m_resolutionX) * std::size_t(m_resolutionY) + 1, 0);
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int x = 0; x < m_resolutionX; x++)
+	{
+		for (int y = 0; y < m_resolutionY; y++)
+		{
+			const auto numberRuns = slabRuns[x].size();
+
+			appendColumn(x, y, slabRuns[x]);
+
+			m_columnOffsets[std::size_t(x) * m_resolutionY + y + 1] = std::uint32_t(slabRuns[x].size() - numberRuns);
+		}
+	}
+
+	// Offsets of columns from the number of runs of each column
+	for (std::size_t i = 1; i < m_columnOffsets.size(); i++)
+	{
+		m_columnOffsets[i] += m_columnOffsets[i - 1];
+	}
+
+	m_runs.clear();
+	m_runs.reserve(m_columnOffsets.back());
+
+	for (auto& runs : slabRuns)
+	{
+		m_runs.insert(m_runs.end(), runs.begin(), runs.end());
+
+		std::vector<Run>().swap(runs);
+	}
+}
+
+const AABB& RunLengthVoxelGrid::boundingBox() const
+{
+	return m_boundingBox;
+}
+
+int RunLengthVoxelGrid::resolutionX() const
+{
+	return m_resolutionX;
+}
+
+int RunLengthVoxelGrid::resolutionY() const
+{
+	return m_resolutionY;
+}
+
+int RunLengthVoxelGrid::resolutionZ() const
+{
+	return m_resolutionZ;
+}
+
+VoxelGrid RunLengthVoxelGrid::toVoxelGrid(VoxelStorage storage) const
+{
+	VoxelGrid grid(m_boundingBox, m_resolutionX, m_resolutionY, m_resolutionZ, storage);
+
+	for (int x = 0; x < m_resolutionX; x++)
+	{
+		for (int y = 0; y < m_resolutionY; y++)
+		{
+			for (auto run = columnBegin(x, y); run != columnEnd(x, y); ++run)
+			{
+				grid.addRange(x, y, run->start, run->end);
+			}
+		}
+	}
+
+	return grid;
+}
+
+std::size_t RunLengthVoxelGrid::numberRuns() const
+{
+	return m_runs.size();
+}
+
+std::size_t RunLengthVoxelGrid::numberVoxels() const
+{
+	std::size_t numberVoxels = 0;
+
+	for (const auto& run : m_runs)
+	{
+		numberVoxels += run.end - run.start;
+	}
+
+	return numberVoxels;
+}
+
+bool RunLengthVoxelGrid::empty() const
+{
+	// Runs are never empty
+	return m_runs.empty();
+}
+
+const RunLengthVoxelGrid::Run* RunLengthVoxelGrid::columnBegin(int x, int y) const
+{
+	return m_runs.data() + m_columnOffsets[std::size_t(x) * m_resolutionY + y];
+}
+
+const RunLengthVoxelGrid::Run* RunLengthVoxelGrid::columnEnd(int x, int y) const
+{
+	return m_runs.data() + m_columnOffsets[std::size_t(x) * m_resolutionY + y + 1];
+}
+
+bool RunLengthVoxelGrid::hasVoxel(int x, int y, int z) const
+{
+	if (x < 0 || y < 0 || z < 0
+	 || x >= m_resolutionX || y >= m_resolutionY || z >= m_resolutionZ)
+	{
+		return false;
+	}
+
+	// First run starting after z, the voxel can only be in the previous run
+	const auto begin = columnBegin(x, y);
+	const auto run = std::upper_bound(begin, columnEnd(x, y), z, [](int value, const Run& run) {
+		return value < run.start;
+	});
+
+	return run != begin && z < (run - 1)->end;
+}
+
+RunLengthVoxelGrid RunLengthVoxelGrid::united(const RunLengthVoxelGrid& other) const
+{
+	assert(m_resolutionX == other.m_resolutionX);
+	assert(m_resolutionY == other.m_resolutionY);
+	assert(m_resolutionZ == other.m_resolutionZ);
+
+	RunLengthVoxelGrid result(m_boundingBox, m_resolutionX, m_resolutionY, m_resolutionZ);
+
+	result.buildColumns([this, &other](int x, int y, std::vector<Run>& runs) {
+		const auto firstRun = runs.size();
+
+		auto a = columnBegin(x, y);
+		auto b = other.columnBegin(x, y);
+		const auto aEnd = columnEnd(x, y);
+		const auto bEnd = other.columnEnd(x, y);
+
+		// Merge runs by increasing start and join those that overlap or touch
+		while (a != aEnd || b != bEnd)
+		{
+			const auto next = (b == bEnd || (a != aEnd && a->start <= b->start)) ? a++ : b++;
+
+			if (runs.size() > firstRun && runs.back().end >= next->start)
+			{
+				runs.back().end = std::max(runs.back().end, next->end);
+			}
+			else
+			{
+				runs.push_back(*next);
+			}
+		}
+	});
+
+	return result;
+}
+
+RunLengthVoxelGrid RunLengthVoxelGrid::intersected(const RunLengthVoxelGrid& other) const
+{
+	assert(m_resolutionX == other.m_resolutionX);
+	assert(m_resolutionY == other.m_resolutionY);
+	assert(m_resolutionZ == other.m_resolutionZ);
+
+	RunLengthVoxelGrid result(m_boundingBox, m_resolutionX, m_resolutionY, m_resolutionZ);
+
+	result.buildColumns([this, &other](int x, int y, std::vector<Run>& runs) {
+		auto a = columnBegin(x, y);
+		auto b = other.columnBegin(x, y);
+		const auto aEnd = columnEnd(x, y);
+		const auto bEnd = other.columnEnd(x, y);
+
+		while (a != aEnd && b != bEnd)
+		{
+			const auto start = std::max(a->start, b->start);
+			const auto end = std::min(a->end, b->end);
+
+			if (start < end)
+			{
+				runs.emplace_back(start, end);
+			}
+
+			// Advance the run that ends first
+			if (a->end < b->end)
+			{
+				++a;
+			}
+			else
+			{
+				++b;
+			}
+		}
+	});
+
+	return result;
+}
+
+void RunLengthVoxelGrid::exportVoxels(const std::string& filename) const
+{
+	// Write voxels to a file
+	std::ofstream file(filename, std::fstream::out);
+
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	// Write the total number of voxels in the file
+	file << numberVoxels() << "\n";
+
+	// Export the voxels in increasing order
+	for (int x = 0; x < m_resolutionX; x++)
+	{
+		for (int y = 0; y < m_resolutionY; y++)
+		{
+			for (auto run = columnBegin(x, y); run != columnEnd(x, y); ++run)
+			{
+				for (int z = run->start; z < run->end; z++)
+				{
+					file << x << " " << y << " " << z << "\n";
+				}
+			}
+		}
+	}
+
+	file.close();
+}
+
+long long countNumberSurfaceVoxels(const RunLengthVoxelGrid& grid)
+{
+	long long numberSurfaceVoxels = 0;
+
+	#pragma omp parallel
+	{
+		// Voxels whose 26 neighbors are in the grid, for the current column
+		std::vector<Run> interior;
+		std::vector<Run> intersection;
+
+		#pragma omp for schedule(dynamic) reduction(+:numberSurfaceVoxels)
+		for (int x = 0; x < grid.resolutionX(); x++)
+		{
+			for (int y = 0; y < grid.resolutionY(); y++)
+			{
+				const auto begin = grid.columnBegin(x, y);
+				const auto end = grid.columnEnd(x, y);
+
+				long long numberVoxels = 0;
+				for (auto run = begin; run != end; ++run)
+				{
+					numberVoxels += run->end - run->start;
+				}
+
+				if (numberVoxels == 0)
+				{
+					continue;
+				}
+
+				// A voxel is inside if the voxels above and below it are in the grid, in the 9 columns around it
+				interior.clear();
+				for (auto run = begin; run != end; ++run)
+				{
+					if (run->start + 1 < run->end - 1)
+					{
+						interior.emplace_back(run->start + 1, run->end - 1);
+					}
+				}
+
+				for (int i = -1; i <= 1 && !interior.empty(); i++)
+				{
+					for (int j = -1; j <= 1 && !interior.empty(); j++)
+					{
+						const auto nx = x + i;
+						const auto ny = y + j;
+
+						if (i == 0 && j == 0)
+						{
+							continue;
+						}
+
+						if (nx < 0 || ny < 0 || nx >= grid.resolutionX() || ny >= grid.resolutionY())
+						{
+							interior.clear();
+						}
+						else
+						{
+							intersection.clear();
+							intersectEroded(interior, grid.columnBegin(nx, ny), grid.columnEnd(nx, ny), intersection);
+							interior.swap(intersection);
+						}
+					}
+				}
+
+				long long numberInteriorVoxels = 0;
+				for (const auto& run : interior)
+				{
+					numberInteriorVoxels += run.end - run.start;
+				}
+
+				numberSurfaceVoxels += numberVoxels - numberInteriorVoxels;
+			}
+		}
+	}
+
+	return numberSurfaceVoxels;
+}
+
+float computeDirectionality(const RunLengthVoxelGrid& grid)
+{
+	// A column is in shade if it has at least one run
+	long long shadowTotal = 0;
+	for (int x = 0; x < grid.resolutionX(); x++)
+	{
+		for (int y = 0; y < grid.resolutionY(); y++)
+		{
+			if (grid.columnBegin(x, y) != grid.columnEnd(x, y))
+			{
+				shadowTotal++;
+			}
+		}
+	}
+
+	// Return the proportion of shadow on the floor of the voxel grid
+	return float(shadowTotal) / float(grid.resolutionX() * grid.resolutionY());
+}
+
+float computeHeight(const RunLengthVoxelGrid& grid)
+{
+	// The last run of each column holds its top voxel
+	int maximumZ = 0;
+	for (int x = 0; x < grid.resolutionX(); x++)
+	{
+		for (int y = 0; y < grid.resolutionY(); y++)
+		{
+			if (grid.columnBegin(x, y) != grid.columnEnd(x, y))
+			{
+				maximumZ = std::max(maximumZ, (grid.columnEnd(x, y) - 1)->end - 1);
+			}
+		}
+	}
+
+	const auto top = grid.boundingBox().lerp({ 0.0f, 0.0f, float(maximumZ) / (grid.resolutionZ() - 1) });
+
+	return top.z() - grid.boundingBox().minZ();
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AABB.h"
+#include "VoxelGrid.h"
+
+/**
+ * \brief A voxel grid storing each column along the Z axis as sorted runs of voxels
+ *        Carved plants have a few runs per column, much less than their number of voxels
+ */
+class RunLengthVoxelGrid
+{
+public:
+	/**
+	 * \brief Interval [start; end[ of voxels along a Z column
+	 */
+	struct Run
+	{
+		std::uint16_t start;
+		std::uint16_t end;
+
+		Run() : start(0), end(0) {}
+
+		Run(int start, int end) :
+			start(std::uint16_t(start)),
+			end(std::uint16_t(end))
+		{
+
+		}
+	};
+
+	RunLengthVoxelGrid(const AABB& boundingBox, int resolutionX, int resolutionY, int resolutionZ);
+
+	/**
+	 * \brief Convert a voxel grid, columns are read 64 voxels at a time
+	 * \param grid A voxel grid
+	 */
+	explicit RunLengthVoxelGrid(const VoxelGrid& grid);
+
+	/**
+	 * \brief Return the bounding box of the voxel grid
+	 * \return The bounding box of the voxel grid
+	 */
+	const AABB& boundingBox() const;
+
+	/**
+	 * \brief Return the resolution of the voxel grid on the X axis
+	 * \return Resolution of the voxel grid on the X axis
+	 */
+	int resolutionX() const;
+
+	/**
+	 * \brief Return the resolution of the voxel grid on the Y axis
+	 * \return Resolution of the voxel grid on the Y axis
+	 */
+	int resolutionY() const;
+
+	/**
+	 * \brief Return the resolution of the voxel grid on the Z axis
+	 * \return Resolution of the voxel grid on the Z axis
+	 */
+	int resolutionZ() const;
+
+	/**
+	 * \brief Convert to a voxel grid
+	 * \param storage The storage of the voxel grid
+	 * \return A voxel grid with the same voxels
+	 */
+	VoxelGrid toVoxelGrid(VoxelStorage storage = VoxelStorage::Dense) const;
+
+	/**
+	 * \brief Return the number of runs in the grid
+	 * \return The number of runs
+	 */
+	std::size_t numberRuns() const;
+
+	/**
+	 * \brief Return the number of voxels in the grid
+	 * \return The number of voxels
+	 */
+	std::size_t numberVoxels() const;
+
+	/**
+	 * \brief Return true if the voxel grid is empty (no voxels)
+	 * \return True if the voxel grid is empty
+	 */
+	bool empty() const;
+
+	/**
+	 * \brief Return the first run of a column
+	 * \param x Integer coordinate on the X axis
+	 * \param y Integer coordinate on the Y axis
+	 * \return A pointer to the first run of the column
+	 */
+	const Run* columnBegin(int x, int y) const;
+
+	/**
+	 * \brief Return the end of the runs of a column
+	 * \param x Integer coordinate on the X axis
+	 * \param y Integer coordinate on the Y axis
+	 * \return A pointer after the last run of the column
+	 */
+	const Run* columnEnd(int x, int y) const;
+
+	/**
+	 * \brief Return true if the voxel exists in the grid
+	 * \param x Integer coordinate on the X axis
+	 * \param y Integer coordinate on the Y axis
+	 * \param z Integer coordinate on the Z axis
+	 * \return True if the voxel is present, false if it is not present
+	 */
+	bool hasVoxel(int x, int y, int z) const;
+
+	/**
+	 * \brief Return the union of this grid and another grid with the same resolution
+	 * \param other Another grid
+	 * \return A grid with voxels in any of the two grids
+	 */
+	RunLengthVoxelGrid united(const RunLengthVoxelGrid& other) const;
+
+	/**
+	 * \brief Return the intersection of this grid and another grid with the same resolution
+	 * \param other Another grid
+	 * \return A grid with voxels in both grids
+	 */
+	RunLengthVoxelGrid intersected(const RunLengthVoxelGrid& other) const;
+
+	/**
+	 * \brief Export the voxel grid in a file, in the same format as VoxelGrid::exportVoxels
+	 * \param filename The path to the file
+	 */
+	void exportVoxels(const std::string& filename) const;
+
+private:
+	/**
+	 * \brief Replace all runs, runs of each column are appended by a function called in parallel on columns
+	 * \param appendColumn Function (x, y, runs) adding the sorted runs of the column (x, y) to a vector
+	 */
+	template<typename AppendColumn>
+	void buildColumns(AppendColumn appendColumn);
+
+	/**
+	 * \brief 3D bounding box containing the voxel grid
+	 */
+	AABB m_boundingBox;
+
+	/**
+	 * \brief Resolution of the voxel grid on the X axis
+	 */
+	int m_resolutionX;
+
+	/**
+	 * \brief Resolution of the voxel grid on the Y axis
+	 */
+	int m_resolutionY;
+
+	/**
+	 * \brief Resolution of the voxel grid on the Z axis
+	 */
+	int m_resolutionZ;
+
+	/**
+	 * \brief Index of the first run of each column, followed by the total number of runs
+	 */
+	std::vector<std::uint32_t> m_columnOffsets;
+
+	/**
+	 * \brief Runs of all columns, column by column
+	 */
+	std::vector<Run> m_runs;
+};
+
+/**
+ * \brief Count the number of voxels on the surface in a voxel grid.
+ *        Any voxel that has less than 26 neighbors is considered on the surface.
+ *        Interior voxels are found by intersecting the eroded runs of the 9 columns around each column
+ * \param grid A voxels grid
+ * \return The number of voxel on the surface
+ */
+long long countNumberSurfaceVoxels(const RunLengthVoxelGrid& grid);
+
+/**
+ * \brief Compute the directionality of a plant in the grid.
+ *		  The computation project the plant from the top and count the proportion of the floor in shade
+ * \param grid A voxel grid with a plant
+ * \return The proportion of shadow on the floor of the voxel grid
+ */
+float computeDirectionality(const RunLengthVoxelGrid& grid);
+
+/**
+ * \brief Compute the plant height
+ * \param grid A voxel grid with a plant
+ * \return The height of the top voxel in the grid
+ */
+float computeHeight(const RunLengthVoxelGrid& grid);
@@ -0,0 +1,323 @@
+#include "SilhouetteMask.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	/**
+	 * \brief Return a word whose bits from first to last (included) are set
+	 */
+	std::uint64_t rangeMask(int first, int last)
+	{
+		const auto belowLast = (last == 63) ? ~std::uint64_t(0) : (std::uint64_t(1) << (last + 1)) - 1;
+		const auto belowFirst = (std::uint64_t(1) << first) - 1;
+
+		return belowLast & ~belowFirst;
+	}
+}
+
+SilhouetteMask::SilhouetteMask() :
+	SilhouetteMask(0, 0)
+{
+	
+}
+
+SilhouetteMask::SilhouetteMask(int width, int height) :
+	m_width(width),
+	m_height(height),
+	m_wordsPerRow((width + 63) / 64),
+	m_bits(std::size_t(height) * std::size_t((width + 63) / 64), 0)
+{
+	
+}
+
+int SilhouetteMask::width() const
+{
+	return m_width;
+}
+
+int SilhouetteMask::height() const
+{
+	return m_height;
+}
+
+void SilhouetteMask::set(int x, int y)
+{
+	m_bits[std::size_t(y) * m_wordsPerRow + (x >> 6)] |= std::uint64_t(1) << (x & 63);
+}
+
+bool SilhouetteMask::boundingRectangle(int& minX, int& minY, int& maxX, int& maxY) const
+{
+	minX = m_width;
+	minY = m_height;
+	maxX = -1;
+	maxY = -1;
+
+	for (int y = 0; y < m_height; y++)
+	{
+		const auto* row = &m_bits[std::size_t(y) * m_wordsPerRow];
+
+		for (int w = 0; w < m_wordsPerRow; w++)
+		{
+			if (row[w] == 0)
+			{
+				continue;
+			}
+
+			minY = std::min(minY, y);
+			maxY = y;
+
+			// Lowest and highest set bits of the word
+			int first = 0;
+			while (((row[w] >> first) & 1) == 0)
+			{
+				first++;
+			}
+
+			int last = 63;
+			while (((row[w] >> last) & 1) == 0)
+			{
+				last--;
+			}
+
+			minX = std::min(minX, w * 64 + first);
+			maxX = std::max(maxX, w * 64 + last);
+		}
+	}
+
+	return maxX >= 0;
+}
+
+SilhouetteMask SilhouetteMask::dilated(int radius) const
+{
+	// Horizontal pass: shift rows by one pixel at a time, carrying bits between words
+	SilhouetteMask horizontal(*this);
+
+	for (int r = 0; r < radius; r++)
+	{
+		#pragma omp parallel for
+		for (int y = 0; y < m_height; y++)
+		{
+			auto* row = &horizontal.m_bits[std::size_t(y) * m_wordsPerRow];
+
+			std::uint64_t previousWord = 0;
+			for (int w = 0; w < m_wordsPerRow; w++)
+			{
+				const auto word = row[w];
+				const auto nextWord = (w + 1 < m_wordsPerRow) ? row[w + 1] : 0;
+
+				row[w] = word | (word << 1) | (word >> 1) | (previousWord >> 63) | (nextWord << 63);
+
+				previousWord = word;
+			}
+		}
+
+		horizontal.clearPadding();
+	}
+
+	// Vertical pass: combine rows in the neighborhood
+	SilhouetteMask result(m_width, m_height);
+
+	#pragma omp parallel for
+	for (int y = 0; y < m_height; y++)
+	{
+		auto* row = &result.m_bits[std::size_t(y) * m_wordsPerRow];
+
+		const auto startRow = std::max(0, y - radius);
+		const auto endRow = std::min(m_height - 1, y + radius);
+
+		for (int neighborRow = startRow; neighborRow <= endRow; neighborRow++)
+		{
+			const auto* source = &horizontal.m_bits[std::size_t(neighborRow) * m_wordsPerRow];
+
+			for (int w = 0; w < m_wordsPerRow; w++)
+			{
+				row[w] |= source[w];
+			}
+		}
+	}
+
+	// The neighborhood of pixels next to the border goes out of the image
+	for (int y = 0; y < m_height; y++)
+	{
+		const auto borderRow = (y < radius || y >= m_height - radius);
+
+		for (int x = 0; x < m_width; x++)
+		{
+			if (borderRow || x < radius || x >= m_width - radius)
+			{
+				result.set(x, y);
+			}
+		}
+	}
+
+	return result;
+}
+
+bool SilhouetteMask::anyInRectangle(int x0, int y0, int x1, int y1) const
+{
+	assert(x0 >= 0 && y0 >= 0 && x1 < m_width && y1 < m_height);
+
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int w = x0 >> 6; w <= x1 >> 6; w++)
+		{
+			const auto start = std::max(x0 - w * 64, 0);
+			const auto end = std::min(x1 - w * 64, 63);
+
+			if (word(w, y) & rangeMask(start, end))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool SilhouetteMask::allInRectangle(int x0, int y0, int x1, int y1) const
+{
+	assert(x0 >= 0 && y0 >= 0 && x1 < m_width && y1 < m_height);
+
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int w = x0 >> 6; w <= x1 >> 6; w++)
+		{
+			const auto mask = rangeMask(std::max(x0 - w * 64, 0), std::min(x1 - w * 64, 63));
+
+			if ((word(w, y) & mask) != mask)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void SilhouetteMask::clearPadding()
+{
+	const auto usedBits = m_width & 63;
+
+	// Every bit of the last word is used
+	if (usedBits == 0)
+	{
+		return;
+	}
+
+	const auto paddingMask = (std::uint64_t(1) << usedBits) - 1;
+
+	for (int y = 0; y < m_height; y++)
+	{
+		m_bits[std::size_t(y) * m_wordsPerRow + m_wordsPerRow - 1] &= paddingMask;
+	}
+}
+
+SilhouetteMask::ColumnRuns SilhouetteMask::columnRuns() const
+{
+	ColumnRuns runs(m_width);
+
+	#pragma omp parallel for
+	for (int x = 0; x < m_width; x++)
+	{
+		int y = 0;
+		while (y < m_height)
+		{
+			// Skip unset pixels
+			while (y < m_height && !get(x, y))
+			{
+				y++;
+			}
+
+			const auto first = y;
+
+			while (y < m_height && get(x, y))
+			{
+				y++;
+			}
+
+			if (first < y)
+			{
+				runs[x].emplace_back(first, y - 1);
+			}
+		}
+	}
+
+	return runs;
+}
+
+OccupancyPyramid::OccupancyPyramid()
+{
+
+}
+
+OccupancyPyramid::OccupancyPyramid(const SilhouetteMask& mask) :
+	m_anyLevels(1, mask)
+{
+	while (m_anyLevels.back().width() > 1 || m_anyLevels.back().height() > 1)
+	{
+		const auto& any = m_anyLevels.back();
+		const auto& all = m_allLevels.empty() ? mask : m_allLevels.back();
+
+		SilhouetteMask nextAny((any.width() + 1) / 2, (any.height() + 1) / 2);
+		SilhouetteMask nextAll(nextAny.width(), nextAny.height());
+
+		// Rows of the next level are written by a single thread
+		#pragma omp parallel for
+		for (int y = 0; y < nextAny.height(); y++)
+		{
+			for (int x = 0; x < nextAny.width(); x++)
+			{
+				// Blocks on the border of the mask have fewer children
+				const auto endX = std::min(2 * x + 1, any.width() - 1);
+				const auto endY = std::min(2 * y + 1, any.height() - 1);
+
+				if (any.anyInRectangle(2 * x, 2 * y, endX, endY))
+				{
+					nextAny.set(x, y);
+				}
+
+				if (all.allInRectangle(2 * x, 2 * y, endX, endY))
+				{
+					nextAll.set(x, y);
+				}
+			}
+		}
+
+		m_anyLevels.push_back(std::move(nextAny));
+		m_allLevels.push_back(std::move(nextAll));
+	}
+}
+
+bool OccupancyPyramid::isEmpty(int x0, int y0, int x1, int y1) const
+{
+	const auto k = level(x0, y0, x1, y1);
+
+	return !m_anyLevels[k].anyInRectangle(x0 >> k, y0 >> k, x1 >> k, y1 >> k);
+}
+
+bool OccupancyPyramid::isFull(int x0, int y0, int x1, int y1) const
+{
+	const auto k = level(x0, y0, x1, y1);
+
+	const auto& levelMask = (k == 0) ? m_anyLevels.front() : m_allLevels[k - 1];
+
+	return levelMask.allInRectangle(x0 >> k, y0 >> k, x1 >> k, y1 >> k);
+}
+
+int OccupancyPyramid::level(int x0, int y0, int x1, int y1) const
+{
+	assert(!m_anyLevels.empty());
+
+	const auto size = std::max(x1 - x0, y1 - y0) + 1;
+
+	// Blocks covering the rectangle are at most size / 8 wider than the rectangle on each side
+	int k = 0;
+	while (k + 1 < int(m_anyLevels.size()) && (size >> (k + 1)) >= 8)
+	{
+		k++;
+	}
+
+	return k;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief A binary image stored with one bit per pixel
+ *        Each row is padded to a whole number of 64-bit words
+ */
+class SilhouetteMask
+{
+public:
+	/**
+	 * \brief For each column of a mask, the runs of consecutive set pixels as [first row; last row]
+	 */
+	using ColumnRuns = std::vector<std::vector<std::pair<int, int>>>;
+
+	SilhouetteMask();
+	SilhouetteMask(int width, int height);
+
+	/**
+	 * \brief Return the width of the mask in pixels
+	 * \return The width of the mask in pixels
+	 */
+	int width() const;
+
+	/**
+	 * \brief Return the height of the mask in pixels
+	 * \return The height of the mask in pixels
+	 */
+	int height() const;
+
+	/**
+	 * \brief Return true if a pixel is set in the mask
+	 * \param x The pixel column
+	 * \param y The pixel row
+	 * \return True if the pixel is set
+	 */
+	bool get(int x, int y) const
+	{
+		return (m_bits[std::size_t(y) * m_wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+	}
+
+	/**
+	 * \brief Return the number of 64-bit words in a row
+	 * \return The number of words in a row
+	 */
+	int wordsPerRow() const
+	{
+		return m_wordsPerRow;
+	}
+
+	/**
+	 * \brief Return 64 consecutive pixels of a row, pixel x is the bit (x & 63) of the word (x >> 6)
+	 * \param index The index of the word in the row
+	 * \param y The pixel row
+	 * \return The bits of the pixels, bits after the end of the row are zeros
+	 */
+	std::uint64_t word(int index, int y) const
+	{
+		return m_bits[std::size_t(y) * m_wordsPerRow + index];
+	}
+
+	/**
+	 * \brief Set a pixel in the mask
+	 * \param x The pixel column
+	 * \param y The pixel row
+	 */
+	void set(int x, int y);
+
+	/**
+	 * \brief Compute the bounding rectangle of set pixels
+	 * \param minX Output the first column with a set pixel
+	 * \param minY Output the first row with a set pixel
+	 * \param maxX Output the last column with a set pixel
+	 * \param maxY Output the last row with a set pixel
+	 * \return False if no pixel is set
+	 */
+	bool boundingRectangle(int& minX, int& minY, int& maxX, int& maxY) const;
+
+	/**
+	 * \brief Dilate the mask with a square structuring element
+	 *        Pixels closer than the radius to the border of the image are also set,
+	 *        so that their neighborhood, that goes out of the image, is considered present
+	 * \param radius Half size of the square, the square is (2 * radius + 1) pixels wide
+	 * \return The dilated mask
+	 */
+	SilhouetteMask dilated(int radius) const;
+
+	/**
+	 * \brief Check whether at least one pixel is set in a rectangle [x0; x1] x [y0; y1] inside the mask
+	 * \return True if a pixel of the rectangle is set
+	 */
+	bool anyInRectangle(int x0, int y0, int x1, int y1) const;
+
+	/**
+	 * \brief Check whether every pixel is set in a rectangle [x0; x1] x [y0; y1] inside the mask
+	 * \return True if all pixels of the rectangle are set
+	 */
+	bool allInRectangle(int x0, int y0, int x1, int y1) const;
+
+	/**
+	 * \brief Compute the runs of set pixels in each column of the mask
+	 * \return For each column, the runs sorted by increasing row
+	 */
+	ColumnRuns columnRuns() const;
+
+private:
+	/**
+	 * \brief Clear bits that are after the last pixel of each row
+	 */
+	void clearPadding();
+
+	/**
+	 * \brief Width of the mask in pixels
+	 */
+	int m_width;
+
+	/**
+	 * \brief Height of the mask in pixels
+	 */
+	int m_height;
+
+	/**
+	 * \brief Number of 64-bit words in a row
+	 */
+	int m_wordsPerRow;
+
+	/**
+	 * \brief Bits of the mask, row by row
+	 */
+	std::vector<std::uint64_t> m_bits;
+};
+
+/**
+ * \brief Pyramid of a mask whose resolution is halved at each level, a pixel of level k covers 2^k x 2^k pixels
+ *        Each level stores whether any pixel and whether all pixels of each block are set, one bit per block,
+ *        so that rectangles are classified in a few words whatever their size
+ */
+class OccupancyPyramid
+{
+public:
+	OccupancyPyramid();
+
+	/**
+	 * \brief Build the pyramid of a mask
+	 * \param mask A mask
+	 */
+	explicit OccupancyPyramid(const SilhouetteMask& mask);
+
+	/**
+	 * \brief Conservatively check that no pixel is set in a rectangle [x0; x1] x [y0; y1] inside the mask
+	 *        The rectangle is checked with blocks of at most an eighth of its size, small rectangles are exact
+	 * \return True only if no pixel of the rectangle is set
+	 */
+	bool isEmpty(int x0, int y0, int x1, int y1) const;
+
+	/**
+	 * \brief Conservatively check that every pixel is set in a rectangle [x0; x1] x [y0; y1] inside the mask
+	 *        The rectangle is checked with blocks of at most an eighth of its size, small rectangles are exact
+	 * \return True only if all pixels of the rectangle are set
+	 */
+	bool isFull(int x0, int y0, int x1, int y1) const;
+
+private:
+	/**
+	 * \brief Return the level whose blocks are at most an eighth of the size of a rectangle
+	 */
+	int level(int x0, int y0, int x1, int y1) const;
+
+	/**
+	 * \brief For each level, blocks with at least one set pixel, the first level is the mask
+	 */
+	std::vector<SilhouetteMask> m_anyLevels;
+
+	/**
+	 * \brief For each level after the first one, blocks whose pixels are all set
+	 */
+	std::vector<SilhouetteMask> m_allLevels;
+};
@@ -1,158 +1,26 @@
 #include "Skeletons.h"
 
+#include <omp.h>
+
 #include <fstream>
 #include <queue>
 
+#include "ConnectedComponents.h"
 #include "MathUtils.h"
-#include "UnionFind.h"
+#include "VoxelKdTree.h"
+#include "VoxelNeighbors.h"
 
 VoxelGrid extractMajorConnectedComponent(const VoxelGrid& grid)
 {
-	const auto nbVoxels = grid.voxels().size();
-
-	UnionFind unionFind(nbVoxels);
-
-	// Union voxels based on connectivity
-	for (const auto& voxel : grid.voxels())
-	{
-		// Coordinates of the current voxel
-		const auto x = voxel.x;
-		const auto y = voxel.y;
-		const auto z = voxel.z;
-
-		const auto iStart = std::max(0, x - 1);
-		const auto iEnd = std::min(grid.resolutionX() - 1, x + 1);
-		const auto jStart = std::max(0, y - 1);
-		const auto jEnd = std::min(grid.resolutionY() - 1, y + 1);
-		const auto kStart = std::max(0, z - 1);
-		const auto kEnd = std::min(grid.resolutionZ() - 1, z + 1);
-
-		// Look at 26-connected neighbors
-		for (int i = iStart; i <= iEnd; i++)
-		{
-			for (int j = jStart; j <= jEnd; j++)
-			{
-				for (int k = kStart; k <= kEnd; k++)
-				{
-					// If it is a neighbor
-					if (i != x || j != y || k != z)
-					{
-						if (grid.hasVoxel(i, j, k))
-						{
-							// Find the index of the voxel in the union find list
-							const auto firstIndex = grid.voxelNumber(x, y, z);
-							const auto secondIndex = grid.voxelNumber(i, j, k);
-
-							// Union between (x, y, z) and (i, j, k)
-							unionFind.unionNodes(firstIndex, secondIndex);
-						}
-					}
-				}
-			}
-		}
-	}
-
-	// List all non empty subsets indexed by root node
-	std::vector<unsigned int> connectedComponentsRoots;
-	for (unsigned int i = 0; i < nbVoxels; i++)
-	{
-		if (unionFind.findNode(i) == i)
-		{
-			connectedComponentsRoots.push_back(i);
-		}
-	}
-	std::sort(connectedComponentsRoots.begin(), connectedComponentsRoots.end());
-
-	// A vector with all connected components
-	std::vector<std::vector<int>> connectedComponents;
-	connectedComponents.reserve(connectedComponentsRoots.size());
-
-	// Add the roots to the connected components
-	for (const auto root : connectedComponentsRoots)
-	{
-		connectedComponents.emplace_back(1, root);
-	}
-
-	// Add every voxels to their connected components
-	for (unsigned int i = 0; i < nbVoxels; i++)
-	{
-		const auto root = unionFind.findNode(i);
-
-		// If the node is not a root
-		if (root != i)
-		{
-			// Search for his connected component
-			const auto it = std::lower_bound(connectedComponentsRoots.begin(),
-				                             connectedComponentsRoots.end(), root);
-
-			if (it != connectedComponentsRoots.end())
-			{
-				const int connectedComp = std::distance(connectedComponentsRoots.begin(), it);
-				connectedComponents[connectedComp].push_back(i);
-			}
-		}
-	}
+	const ConnectedComponents components(grid);
 
-	// Find the major connected component
-	unsigned int majorComponent = 0;
-	for (unsigned int i = 1; i < connectedComponents.size(); i++)
-	{
-		if (connectedComponents[i].size() > connectedComponents[majorComponent].size())
-		{
-			majorComponent = i;
-		}
-	}
-
-	// Setup a new grid with the major connected component
-	VoxelGrid majorComponentGrid(grid.boundingBox(), grid.resolutionX(), grid.resolutionY(), grid.resolutionZ());
-
-	if (!connectedComponents.empty())
-	{
-		for (const auto& voxelIndex : connectedComponents[majorComponent])
-		{
-			const auto& voxel = grid.voxels()[voxelIndex];
-
-			majorComponentGrid.add(voxel.x, voxel.y, voxel.z);
-		}
-	}
-
-	return majorComponentGrid;
+	return components.extractLargestComponents(1);
 }
 
 std::vector<Voxel> extractSkeletonEndpoints(const VoxelGrid& grid)
 {
-	std::vector<Voxel> endpoints;
-
-	// Look at every voxels and count the number of voxels in the 26-connected neighborhood
-#pragma omp parallel for
-	for (int i = 0; i < grid.voxels().size(); i++)
-	{
-		// The current voxel
-		const auto& voxel = grid.voxels()[i];
-
-		// Number of neighbors of the current voxel
-		const auto numberNeighbors = grid.numberNeighbors(voxel);
-
-		// If the current voxel has exactly 1 neighbor, it's an end point
-		if (numberNeighbors <= 1)
-		{
-			// Keep this voxel
-#pragma omp critical(extract_end_points)
-			{
-				endpoints.emplace_back(voxel.x, voxel.y, voxel.z);
-			}
-		}
-	}
-
-	// Generate a new grid with endpoints
-	VoxelGrid endpointsGrid(grid.boundingBox(), grid.resolutionX(), grid.resolutionY(), grid.resolutionZ());
-
-	for (const auto& voxel : endpoints)
-	{
-		endpointsGrid.add(voxel.x, voxel.y, voxel.z);
-	}
-
-	return endpoints;
+	// Voxels with at most 1 neighbor in the 26-connected neighborhood are end points
+	return extractEndpointVoxels(grid).voxels();
 }
 
 Voxel findAndRemoveLowestEndpoint(std::vector<Voxel>& endpoints)
@@ -265,6 +133,9 @@ shortestPathsFromSkeleton(
 			numberOfSuccessors[pred]++;
 		}
 	}
+	// Number of neighbors of all voxels, in the order of the voxels
+	const auto numberNeighbors = computeNumberNeighbors(grid);
+
 	// If a voxel has no successor, it is on the border of the graph
 	for (unsigned int i = 0; i < numberOfSuccessors.size(); i++)
 	{
@@ -273,11 +144,8 @@ shortestPathsFromSkeleton(
 		{
 			const auto voxel = grid.voxels()[i];
 
-			// Number of neighbors of the current voxel
-			const auto numberNeighbors = grid.numberNeighbors(voxel);
-
 			// If the current voxel has at most 2 neighbors, it may be an endpoint we previously missed
-			if (numberNeighbors <= 2)
+			if (numberNeighbors[i] <= 2)
 			{
 				// We check that it's not the startingVoxel and it's not in the list of endpoints
 				const auto itEndpoint = std::find(endpoints.begin(), endpoints.end(), voxel);
@@ -583,7 +451,8 @@ VoxelGrid generateGridFromSkeleton(const VoxelGrid& initialGrid, const std::vect
 		initialGrid.boundingBox(),
 		initialGrid.resolutionX(),
 		initialGrid.resolutionY(),
-		initialGrid.resolutionZ());
+		initialGrid.resolutionZ(),
+		initialGrid.storage());
 
 	for (const auto& path : paths)
 	{
@@ -643,20 +512,166 @@ int nearestPath(const VoxelGrid& grid, const std::vector<std::vector<Voxel>>& pa
 	return nearestPath;
 }
 
+namespace
+{
+	/**
+	 * \brief Call a function on the number of each 26-connected neighbor of a voxel in the grid
+	 */
+	template<typename Function>
+	void forEachNeighborNumber(const VoxelGrid& grid, const Voxel& voxel, Function function)
+	{
+		for (int i = -1; i <= 1; i++)
+		{
+			for (int j = -1; j <= 1; j++)
+			{
+				for (int k = -1; k <= 1; k++)
+				{
+					if ((i != 0 || j != 0 || k != 0) && grid.hasVoxel(voxel.x + i, voxel.y + j, voxel.z + k))
+					{
+						function(grid.voxelNumber(voxel.x + i, voxel.y + j, voxel.z + k));
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * \brief Label some voxels of the grid with the index of the nearest path by Euclidean distance
+	 * \param voxelNumbers Numbers of the voxels to label
+	 * \param labels Index of the nearest path of each voxel of the grid, updated for the given voxels
+	 */
+	void assignVoxelsToEuclideanNearestPath(
+		const VoxelGrid& grid,
+		const std::vector<std::vector<Voxel>>& paths,
+		const std::vector<int>& voxelNumbers,
+		std::vector<int>& labels)
+	{
+		// One KD-tree of the voxels of all paths, paths are concatenated in order so that ties go to the first path
+		std::vector<Voxel> pathVoxels;
+		std::vector<int> pathOfVoxel;
+
+		for (int i = 0; i < paths.size(); i++)
+		{
+			pathVoxels.insert(pathVoxels.end(), paths[i].begin(), paths[i].end());
+			pathOfVoxel.insert(pathOfVoxel.end(), paths[i].size(), i);
+		}
+
+		const VoxelKdTree tree(grid, pathVoxels);
+
+		const auto& voxels = grid.voxels();
+
+		// 3D coordinates of the voxels
+		std::vector<QVector3D> points(voxelNumbers.size());
+
+#pragma omp parallel for
+		for (int i = 0; i < voxelNumbers.size(); i++)
+		{
+			points[i] = grid.voxel(voxels[voxelNumbers[i]]);
+		}
+
+		// What is the nearest path to each voxel
+		const auto nearestVoxels = tree.nearest(points);
+
+		for (int i = 0; i < voxelNumbers.size(); i++)
+		{
+			labels[voxelNumbers[i]] = (nearestVoxels[i] >= 0) ? pathOfVoxel[nearestVoxels[i]] : -1;
+		}
+	}
+}
+
 std::vector<int> assignVoxelsToNearestPath(const VoxelGrid& grid, const std::vector<std::vector<Voxel>>& paths)
 {
 	const auto& voxels = grid.voxels();
 
 	std::vector<int> nearestPathPerVoxel(voxels.size(), -1);
 
+	// Number of 26-connected steps from the nearest path, -1 if the voxel has not been reached yet
+	std::vector<int> levels(voxels.size(), -1);
+
+	// Voxels of the paths are the sources, a voxel shared by several paths goes to the first one
+	std::vector<int> frontier;
+
+	for (int i = 0; i < paths.size(); i++)
+	{
+		for (const auto& voxel : paths[i])
+		{
+			const auto number = grid.voxelNumber(voxel.x, voxel.y, voxel.z);
+
+			if (number >= 0 && levels[number] < 0)
+			{
+				levels[number] = 0;
+				nearestPathPerVoxel[number] = i;
+				frontier.push_back(number);
+			}
+		}
+	}
+
+	// Breadth-first search from all paths at once, one level at a time
+	std::vector<std::vector<int>> candidates(omp_get_max_threads());
+
+	for (int level = 1; !frontier.empty(); level++)
+	{
+		// Neighbors of the frontier not reached yet, a voxel may be found by several threads
 #pragma omp parallel for
-	for (int i = 0; i < voxels.size(); i++)
+		for (int i = 0; i < frontier.size(); i++)
+		{
+			auto& threadCandidates = candidates[omp_get_thread_num()];
+
+			forEachNeighborNumber(grid, voxels[frontier[i]], [&](int neighbor) {
+				if (levels[neighbor] < 0)
+				{
+					threadCandidates.push_back(neighbor);
+				}
+			});
+		}
+
+		frontier.clear();
+
+		for (auto& threadCandidates : candidates)
+		{
+			for (const auto candidate : threadCandidates)
+			{
+				if (levels[candidate] < 0)
+				{
+					levels[candidate] = level;
+					frontier.push_back(candidate);
+				}
+			}
+
+			threadCandidates.clear();
+		}
+
+		// Each voxel of the new frontier takes the first path among its neighbors of the previous level
+#pragma omp parallel for
+		for (int i = 0; i < frontier.size(); i++)
+		{
+			int path = std::numeric_limits<int>::max();
+
+			forEachNeighborNumber(grid, voxels[frontier[i]], [&](int neighbor) {
+				if (levels[neighbor] == level - 1)
+				{
+					path = std::min(path, nearestPathPerVoxel[neighbor]);
+				}
+			});
+
+			nearestPathPerVoxel[frontier[i]] = path;
+		}
+	}
+
+	// Voxels not connected to any path go to the nearest path in space
+	std::vector<int> unreachedVoxels;
+
+	for (int i = 0; i < levels.size(); i++)
 	{
-		// 3D coordinates of this voxel
-		const auto point = grid.voxel(voxels[i]);
+		if (levels[i] < 0)
+		{
+			unreachedVoxels.push_back(i);
+		}
+	}
 
-		// What is the nearest path to this voxel
-		nearestPathPerVoxel[i] = nearestPath(grid, paths, point);
+	if (!unreachedVoxels.empty())
+	{
+		assignVoxelsToEuclideanNearestPath(grid, paths, unreachedVoxels, nearestPathPerVoxel);
 	}
 
 	return nearestPathPerVoxel;
@@ -756,7 +771,7 @@ void exportSegmentedLeaves(
 	const std::string& filepath)
 {
 	// For each leaf, including the trunk, segment voxels
-	VoxelGrid segmentedGrid(grid.boundingBox(), grid.resolutionX(), grid.resolutionY(), grid.resolutionZ());
+	VoxelGrid segmentedGrid(grid.boundingBox(), grid.resolutionX(), grid.resolutionY(), grid.resolutionZ(), grid.storage());
 
 	for (int i = 0; i < numberOfSegments; i++)
 	{
@@ -8,8 +8,7 @@
 #include "AbstractSkeletonBranchClassifier.h"
 
 /**
- * \brief Extract the major connected component from a voxel grid
- *        Voxels in the grid must be sorted, this assumption allows the algorithm to run faster
+ * \brief Extract the major 26-connected component from a voxel grid
  * \param grid The voxel grid
  */
 VoxelGrid extractMajorConnectedComponent(const VoxelGrid& grid);
@@ -131,6 +130,8 @@ int nearestPath(const VoxelGrid& grid, const std::vector<std::vector<Voxel>>& pa
 
 /**
  * \brief For each voxel in the grid, find the nearest path in the list of paths
+ *        Distances are geodesic: the number of 26-connected steps through the voxels of the grid, from all paths at once
+ *        Voxels not connected to any path are assigned to the nearest path by Euclidean distance
  * \param grid A voxel grid
  * \param paths A list of voxel paths, within the voxel grid
  * \return A vector containing for each voxel of the grid, the index of the nearest path
@@ -1,60 +1,83 @@
 #include "UnionFind.h"
 
-UnionFind::UnionFind(unsigned int nbNodes)
-{
-	m_nodes.resize(nbNodes);
+#include <cassert>
+#include <utility>
 
+UnionFind::UnionFind(unsigned int nbNodes) :
+	m_parents(nbNodes)
+{
 	for (unsigned int i = 0; i < nbNodes; i++)
 	{
-		m_nodes[i].parent = i;
-		m_nodes[i].rang = 0;
-		m_nodes[i].children = 1;
+		m_parents[i].store(i, std::memory_order_relaxed);
 	}
 }
 
 unsigned int UnionFind::findNode(unsigned int node)
 {
-	if (m_nodes[node].parent != node)
+	while (true)
 	{
-		m_nodes[node].parent = findNode(m_nodes[node].parent);
-	}
+		auto parent = m_parents[node].load();
+
+		if (parent == node)
+		{
+			return node;
+		}
 
-	return m_nodes[node].parent;
+		const auto grandParent = m_parents[parent].load();
+
+		// Link the node to its grand parent, it does not matter if another thread changed the parent meanwhile
+		if (grandParent != parent)
+		{
+			m_parents[node].compare_exchange_weak(parent, grandParent);
+		}
+
+		node = grandParent;
+	}
 }
 
 unsigned int UnionFind::size(unsigned int node)
 {
-	const auto root = findNode(node);
+	assert(m_sizes.size() == m_parents.size());
 
-	return m_nodes[root].children;
+	return m_sizes[findNode(node)];
 }
 
 unsigned int UnionFind::unionNodes(unsigned int nodeX, unsigned int nodeY)
 {
-	const auto rootX = findNode(nodeX);
-	const auto rootY = findNode(nodeY);
-	auto newRoot = rootX;
-
-	if (rootX != rootY)
+	while (true)
 	{
-		if (m_nodes[rootX].rang < m_nodes[rootY].rang)
+		auto rootX = findNode(nodeX);
+		auto rootY = findNode(nodeY);
+
+		if (rootX == rootY)
 		{
-			m_nodes[rootX].parent = rootY;
-			m_nodes[rootY].children += m_nodes[rootX].children;
-			newRoot = rootY;
+			return rootX;
 		}
-		else if (m_nodes[rootX].rang > m_nodes[rootY].rang)
+
+		// Parents always have a smaller index than their children, so there is no cycle
+		if (rootX < rootY)
 		{
-			m_nodes[rootY].parent = rootX;
-			m_nodes[rootX].children += m_nodes[rootY].children;
+			std::swap(rootX, rootY);
 		}
-		else
+
+		// The link fails if another thread has just linked rootX, then start again from the new roots
+		auto expected = rootX;
+		if (m_parents[rootX].compare_exchange_strong(expected, rootY))
 		{
-			m_nodes[rootY].parent = rootX;
-			m_nodes[rootX].rang++;
-			m_nodes[rootX].children += m_nodes[rootY].children;
+			return rootY;
 		}
+
+		nodeX = rootX;
+		nodeY = rootY;
 	}
+}
+
+void UnionFind::countSizes()
+{
+	m_sizes.assign(m_parents.size(), 0);
 
-	return newRoot;
+	for (unsigned int i = 0; i < m_parents.size(); i++)
+	{
+		m_sizes[findNode(i)]++;
+	}
 }
@@ -1,16 +1,19 @@
 #pragma once
 
+#include <atomic>
 #include <vector>
 
-using namespace std;
-
+/**
+ * @brief Disjoint sets of nodes, safe to use from several threads at the same time.
+ * Each node only stores the index of its parent, the root of a subset is its smallest node.
+ */
 class UnionFind
 {
 public:
 	UnionFind(unsigned int nbNodes);
-	
+
 	/**
-	 * @brief Find Return the root of a node.
+	 * @brief Find Return the root of a node, with path halving.
 	 * @param node A node.
 	 * @return The root of the node.
 	 */
@@ -18,26 +21,30 @@ public:
 
 	/**
 	 * @brief Size Return the size of the subset in which a node is.
+	 * The sizes must have been counted after the last union.
 	 * @param node A node.
 	 * @return The size of the subset in which the node is.
 	 */
 	unsigned int size(unsigned int node);
 
 	/**
-	 * @brief Union Unify two nodes.
+	 * @brief Union Unify two nodes, the root with the greatest index is linked to the other root.
 	 * @param nodeX A node X.
 	 * @param nodeY A node Y.
 	 * @return The new root of the two nodes.
 	 */
 	unsigned int unionNodes(unsigned int nodeX, unsigned int nodeY);
 
+	/**
+	 * @brief CountSizes Count the size of every subset, must not be called during unions.
+	 */
+	void countSizes();
+
 private:
-	struct Node
-	{
-		unsigned int parent;
-		unsigned int rang;
-		unsigned int children;
-	};
-
-	vector<Node> m_nodes;
+	std::vector<std::atomic<unsigned int>> m_parents;
+
+	/**
+	 * Size of the subset of each root, only allocated when sizes are counted
+	 */
+	std::vector<unsigned int> m_sizes;
 };
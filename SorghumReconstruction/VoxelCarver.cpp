@@ -2,21 +2,137 @@
 
 #include <omp.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <iterator>
+#include <limits>
 
 #include <QDebug>
+#include <QDir>
+#include <QVector4D>
 #include <QtMath>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "MathUtils.h"
 #include "Thinning.h"
+#include "VoxelKey.h"
 
-VoxelCarver::VoxelCarver(const AABB& boundingBox, int resolutionX, int resolutionY, int resolutionZ) :
+namespace
+{
+	/**
+	 * \brief Clip a polygon with a half-space, Sutherland-Hodgman algorithm
+	 * \param polygon The vertices of the polygon
+	 * \param plane The half-space of points p such that dot(plane, (p, 1)) >= 0
+	 * \return The vertices of the clipped polygon
+	 */
+	std::vector<QVector3D> clipPolygon(const std::vector<QVector3D>& polygon, const QVector4D& plane)
+	{
+		std::vector<QVector3D> clipped;
+
+		for (std::size_t i = 0; i < polygon.size(); i++)
+		{
+			const auto& current = polygon[i];
+			const auto& next = polygon[(i + 1) % polygon.size()];
+
+			const auto currentDistance = QVector4D::dotProduct(plane, QVector4D(current, 1.0f));
+			const auto nextDistance = QVector4D::dotProduct(plane, QVector4D(next, 1.0f));
+
+			if (currentDistance >= 0.0f)
+			{
+				clipped.push_back(current);
+			}
+
+			// The edge crosses the plane
+			if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+			{
+				const auto t = currentDistance / (currentDistance - nextDistance);
+				clipped.push_back(current + t * (next - current));
+			}
+		}
+
+		return clipped;
+	}
+
+	/**
+	 * \brief Shrink a box to the bounding box of its intersection with half-spaces
+	 *        Vertices of the intersection are on the faces of the box, as long as the planes
+	 *        only meet out of the box, so faces are clipped one by one
+	 * \param minimum The minimum corner of the box
+	 * \param maximum The maximum corner of the box
+	 * \param planes The half-spaces of points p such that dot(plane, (p, 1)) >= 0
+	 * \return False if the intersection is empty
+	 */
+	bool clipBox(QVector3D& minimum, QVector3D& maximum, const std::vector<QVector4D>& planes)
+	{
+		const auto corner = [&minimum, &maximum](int x, int y, int z)
+		{
+			return QVector3D(x ? maximum.x() : minimum.x(),
+			                 y ? maximum.y() : minimum.y(),
+			                 z ? maximum.z() : minimum.z());
+		};
+
+		const std::vector<std::vector<QVector3D>> faces = {
+			{ corner(0, 0, 0), corner(0, 1, 0), corner(0, 1, 1), corner(0, 0, 1) },
+			{ corner(1, 0, 0), corner(1, 1, 0), corner(1, 1, 1), corner(1, 0, 1) },
+			{ corner(0, 0, 0), corner(1, 0, 0), corner(1, 0, 1), corner(0, 0, 1) },
+			{ corner(0, 1, 0), corner(1, 1, 0), corner(1, 1, 1), corner(0, 1, 1) },
+			{ corner(0, 0, 0), corner(1, 0, 0), corner(1, 1, 0), corner(0, 1, 0) },
+			{ corner(0, 0, 1), corner(1, 0, 1), corner(1, 1, 1), corner(0, 1, 1) }
+		};
+
+		QVector3D clippedMinimum(std::numeric_limits<float>::max(),
+		                         std::numeric_limits<float>::max(),
+		                         std::numeric_limits<float>::max());
+		QVector3D clippedMaximum(std::numeric_limits<float>::lowest(),
+		                         std::numeric_limits<float>::lowest(),
+		                         std::numeric_limits<float>::lowest());
+		auto empty = true;
+
+		for (auto face : faces)
+		{
+			for (const auto& plane : planes)
+			{
+				face = clipPolygon(face, plane);
+			}
+
+			for (const auto& vertex : face)
+			{
+				clippedMinimum = QVector3D(std::min(clippedMinimum.x(), vertex.x()),
+				                           std::min(clippedMinimum.y(), vertex.y()),
+				                           std::min(clippedMinimum.z(), vertex.z()));
+				clippedMaximum = QVector3D(std::max(clippedMaximum.x(), vertex.x()),
+				                           std::max(clippedMaximum.y(), vertex.y()),
+				                           std::max(clippedMaximum.z(), vertex.z()));
+				empty = false;
+			}
+		}
+
+		if (empty)
+		{
+			return false;
+		}
+
+		minimum = clippedMinimum;
+		maximum = clippedMaximum;
+
+		return true;
+	}
+}
+
+VoxelCarver::VoxelCarver(const AABB& boundingBox,
+                         int resolutionX,
+                         int resolutionY,
+                         int resolutionZ,
+                         VoxelStorage storage) :
 	m_colorThreshold(235),
 	m_maximumRadiusAroundVoxel(0.0f),
-	m_voxelGrid(boundingBox, resolutionX, resolutionY, resolutionZ),
-	m_voxelGridReady(false)
+	m_carvingMode(CarvingMode::Hierarchical),
+	m_voxelGrid(boundingBox, resolutionX, resolutionY, resolutionZ, storage),
+	m_voxelGridReady(false),
+	m_incrementalVoxelGridValid(false),
+	m_numberCarvedCameras(0)
 {
 	
 }
@@ -24,11 +140,93 @@ VoxelCarver::VoxelCarver(const AABB& boundingBox, int resolutionX, int resolutio
 void VoxelCarver::setMaximumRadiusAroundVoxel(float maximumRadiusAroundVoxel)
 {
 	m_maximumRadiusAroundVoxel = maximumRadiusAroundVoxel;
+
+	// The size of neighborhoods depends on the radius
+	for (auto& cameraImage : m_cameras)
+	{
+		updateDilatedSilhouettes(cameraImage);
+	}
+
+	// Visibility of voxels from all cameras changes
+	resetVisibilityCounts();
+
+	m_voxelGridReady = false;
+}
+
+void VoxelCarver::setCarvingMode(CarvingMode carvingMode)
+{
+	m_carvingMode = carvingMode;
+
+	// Other modes do not maintain visibility counts
+	resetVisibilityCounts();
+}
+
+void VoxelCarver::setProjectionCacheDirectory(const QString& directory)
+{
+	m_projectionCacheDirectory = directory;
 }
 
 void VoxelCarver::addCameraImage(const Camera& camera, const cv::Mat& image, int offsetX, int offsetY)
 {
-	m_cameras.emplace_back(camera, image, offsetX, offsetY);
+	// Only the silhouette of the object is kept from the picture
+	m_cameras.emplace_back(camera, computeSilhouette(image), offsetX, offsetY);
+	updateDilatedSilhouettes(m_cameras.back());
+
+	// New cameras are tested last until statistics are updated
+	m_cameraOrder.push_back(int(m_cameras.size()) - 1);
+	m_cameraRejectionRates.push_back(0.0f);
+
+	// The camera is added to visibility counts by the next incremental pass
+	m_countedCameras.push_back(false);
+
+	m_voxelGridReady = false;
+}
+
+void VoxelCarver::removeCamera(int index)
+{
+	assert(index >= 0 && index < int(m_cameras.size()));
+
+	// Counts are stored on 8 bits, with more cameras the next pass carves the grid from scratch
+	const auto countable = int(m_cameras.size()) - 1 <= std::numeric_limits<unsigned char>::max();
+
+	if (m_incrementalVoxelGridValid && m_visibilityCounts.empty() && countable)
+	{
+		// Counts are only needed to restore voxels, they are computed with the other cameras at the first removal
+		m_visibilityCounts.assign(std::size_t(m_voxelGrid.resolutionX())
+		                        * std::size_t(m_voxelGrid.resolutionY())
+		                        * std::size_t(m_voxelGrid.resolutionZ()), 0);
+
+		for (int c = 0; c < int(m_cameras.size()); c++)
+		{
+			if (c != index)
+			{
+				updateVisibilityCounts(c, 1);
+				m_countedCameras[c] = true;
+			}
+		}
+	}
+	else if (m_countedCameras[index])
+	{
+		// Voxels seen by the camera are not seen by one more camera anymore
+		updateVisibilityCounts(index, -1);
+	}
+
+	// Voxels rejected by this camera may be restored
+	m_incrementalVoxelGridValid = false;
+
+	m_cameras.erase(m_cameras.begin() + index);
+	m_cameraRejectionRates.erase(m_cameraRejectionRates.begin() + index);
+	m_countedCameras.erase(m_countedCameras.begin() + index);
+
+	// Following cameras are shifted by one
+	m_cameraOrder.erase(std::find(m_cameraOrder.begin(), m_cameraOrder.end(), index));
+	for (auto& c : m_cameraOrder)
+	{
+		if (c > index)
+		{
+			c--;
+		}
+	}
 
 	m_voxelGridReady = false;
 }
@@ -36,122 +234,1913 @@ void VoxelCarver::addCameraImage(const Camera& camera, const cv::Mat& image, int
 void VoxelCarver::clearCameras()
 {
 	m_cameras.clear();
+	m_cameraOrder.clear();
+	m_cameraRejectionRates.clear();
+	m_countedCameras.clear();
+
+	resetVisibilityCounts();
 }
 
 bool VoxelCarver::isInside(const QVector3D& point) const
 {
-	bool inside = true;
-	
-	for (const auto& cameraImage : m_cameras)
+	for (const auto c : m_cameraOrder)
 	{
-		// Dimensions of the image
-		const auto width = float(cameraImage.image.cols);
-		const auto height = float(cameraImage.image.rows);
+		// The voxel is not visible from this camera, therefore it is not part of the object
+		if (!isVisibleFromCamera(m_cameras[c], point))
+		{
+			return false;
+		}
+	}
 
-		// Diagonal point in the image plane
-		const auto diagonalPoint = point + m_maximumRadiusAroundVoxel * (cameraImage.camera.up() + cameraImage.camera.right()) * M_SQRT1_2;
-		
-		// Real coordinates of the pixel on the image
-		const auto realPixel = cameraImage.camera.project(point, width, height);
-		// Real coordinates of the pixel on the image
-		const auto realDiagonalPixel = cameraImage.camera.project(diagonalPoint, width, height);
+	return true;
+}
+
+bool VoxelCarver::isVisibleFromCamera(const CameraImage& cameraImage, const QVector3D& point) const
+{
+	// Real coordinates of the pixel on the image
+	const auto realPixel = cameraImage.projection.project(point);
+	// Real coordinates of the diagonal pixel on the image
+	const auto realDiagonalPixel = cameraImage.projection.project(point + cameraImage.diagonal);
+
+	return isVisibleFromCamera(cameraImage, realPixel, realDiagonalPixel);
+}
+
+bool VoxelCarver::isVisibleFromCamera(const CameraImage& cameraImage, const QVector2D& realPixel, const QVector2D& realDiagonalPixel) const
+{
+	// Size of the neighborhood around the current pixel
+	const auto offset = int(std::ceil(realPixel.distanceToPoint(realDiagonalPixel)));
 
-		// Size of the neighborhood around the current pixel
-		const auto offset = int(std::ceil(realPixel.distanceToPoint(realDiagonalPixel)));
+	const auto x = int(std::round(realPixel.x() + float(cameraImage.offsetX)));
+	const auto y = int(std::round(realPixel.y() + float(cameraImage.offsetY)));
 
-		// Look at neighboring positions
-		// If at least one pixel from the neighborhood is present in the image, the voxel is inside
-		bool pixelExists = false;
-		for (int offsetX = -offset; offsetX <= offset && !pixelExists; offsetX++)
+	const auto dilatedIndex = offset - cameraImage.minimumOffset;
+
+	// If the point is visible in the image
+	if (x >= 0 && y >= 0 && x < cameraImage.silhouette.width() && y < cameraImage.silhouette.height()
+	 && dilatedIndex >= 0 && dilatedIndex < int(cameraImage.dilatedSilhouettes.size()))
+	{
+		// The dilated silhouette tells whether at least one pixel from the neighborhood is in the object
+		return cameraImage.dilatedSilhouettes[dilatedIndex].get(x, y);
+	}
+
+	// Look at neighboring positions
+	// If at least one pixel from the neighborhood is present in the image, the voxel is inside
+	for (int offsetX = -offset; offsetX <= offset; offsetX++)
+	{
+		for (int offsetY = -offset; offsetY <= offset; offsetY++)
 		{
-			for (int offsetY = -offset; offsetY <= offset && !pixelExists; offsetY++)
-			{
-				const auto x = int(std::round(realPixel.x() + float(offsetX) + float(cameraImage.offsetX)));
-				const auto y = int(std::round(realPixel.y() + float(offsetY) + float(cameraImage.offsetY)));
+			const auto neighborX = int(std::round(realPixel.x() + float(offsetX) + float(cameraImage.offsetX)));
+			const auto neighborY = int(std::round(realPixel.y() + float(offsetY) + float(cameraImage.offsetY)));
 
-				// If the point is visible in the image
-				if (x >= 0 && y >= 0 && x < cameraImage.image.cols && y < cameraImage.image.rows)
-				{					
-					// If the corresponding pixel in the image is not white, the point is part the object
-					if (isPixelInObject(cameraImage.image, y, x))
-					{
-						pixelExists = true;
-					}
-				}
-				else
+			// If the point is visible in the image
+			if (neighborX >= 0 && neighborY >= 0 && neighborX < cameraImage.silhouette.width() && neighborY < cameraImage.silhouette.height())
+			{
+				// If the corresponding pixel is in the silhouette, the point is part the object
+				if (cameraImage.silhouette.get(neighborX, neighborY))
 				{
-					// If the pixel is not visible in the image, we consider it as present
-					// so that we don't remove it even if it is visible from other views
-					pixelExists = true;
+					return true;
 				}
 			}
+			else
+			{
+				// If the pixel is not visible in the image, we consider it as present
+				// so that we don't remove it even if it is visible from other views
+				return true;
+			}
 		}
-		
-		// The voxel is not visible from this camera, therefore it is not part of the object
-		if (!pixelExists)
+	}
+
+	return false;
+}
+
+std::uint64_t VoxelCarver::visibleLanesFromCamera(
+	const CameraImage& cameraImage,
+	const BatchSilhouettes& batchSilhouettes,
+	const QVector2D& realPixel,
+	const QVector2D& realDiagonalPixel) const
+{
+	// Same tests as isVisibleFromCamera, for all plants at once
+	const auto offset = int(std::ceil(realPixel.distanceToPoint(realDiagonalPixel)));
+
+	const auto x = int(std::round(realPixel.x() + float(cameraImage.offsetX)));
+	const auto y = int(std::round(realPixel.y() + float(cameraImage.offsetY)));
+
+	const auto width = cameraImage.silhouette.width();
+	const auto height = cameraImage.silhouette.height();
+
+	const auto dilatedIndex = offset - cameraImage.minimumOffset;
+
+	if (x >= 0 && y >= 0 && x < width && y < height
+	 && dilatedIndex >= 0 && dilatedIndex < int(batchSilhouettes.dilatedLanes.size()))
+	{
+		return batchSilhouettes.load(batchSilhouettes.dilatedLanes[dilatedIndex], std::size_t(y) * width + x);
+	}
+
+	std::uint64_t lanes = 0;
+
+	for (int offsetX = -offset; offsetX <= offset; offsetX++)
+	{
+		for (int offsetY = -offset; offsetY <= offset; offsetY++)
 		{
-			inside = false;
-			break;
+			const auto neighborX = int(std::round(realPixel.x() + float(offsetX) + float(cameraImage.offsetX)));
+			const auto neighborY = int(std::round(realPixel.y() + float(offsetY) + float(cameraImage.offsetY)));
+
+			if (neighborX >= 0 && neighborY >= 0 && neighborX < width && neighborY < height)
+			{
+				lanes |= batchSilhouettes.load(batchSilhouettes.lanes, std::size_t(neighborY) * width + neighborX);
+			}
+			else
+			{
+				// Pixels out of the image are present for all plants
+				return ~std::uint64_t(0);
+			}
 		}
 	}
 
-	return inside;
+	return lanes;
 }
 
-
 void VoxelCarver::process()
 {
-	const int defaultVoxelReserve = m_voxelGrid.resolutionY() * m_voxelGrid.resolutionZ();
-	
-	m_voxelGrid.clear();
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	// Voxels out of the frusta of the silhouettes are not traversed
+	const auto domain = computeCarvingDomain();
+
+	qDebug() << "Carving domain:" << domain.sizeX() << "x" << domain.sizeY() << "x" << domain.sizeZ() << "voxels";
+
+	std::vector<Voxel> voxels;
+
+	if (m_carvingMode == CarvingMode::Incremental)
+	{
+		// All cameras are tested on all voxels, their order does not matter
+		processIncremental(domain, voxels);
+	}
+	else
+	{
+		// Test the most selective cameras first
+		updateCameraOrder();
+
+		if (m_carvingMode == CarvingMode::Hierarchical)
+		{
+			processHierarchical(domain, voxels);
+		}
+		else if (m_carvingMode == CarvingMode::ColumnInterval)
+		{
+			processColumnIntervals(domain, voxels);
+		}
+		else
+		{
+			processExhaustive(domain, voxels);
+		}
+	}
+
+	// Voxels are already sorted
+	m_voxelGrid.setVoxels(std::move(voxels));
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	// Calculating total time taken by the program. 
+	const double elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+	qInfo() << "Voxel carving time: " << elapsedTime << " ms";
+
+	m_voxelGridReady = true;
+}
+
+std::vector<VoxelGrid> VoxelCarver::processBatch(const std::vector<std::vector<cv::Mat>>& images) const
+{
+	// One bit of a 64-bit word per plant
+	const int maximumNumberPlants = 64;
+
+	const auto numberPlants = int(images.size());
+
+	if (numberPlants > maximumNumberPlants)
+	{
+		qWarning() << "Cannot carve more than" << maximumNumberPlants << "plants in a batch";
+		return {};
+	}
+
+	for (const auto& plantImages : images)
+	{
+		if (plantImages.size() != m_cameras.size())
+		{
+			qWarning() << "Each plant must have one picture per camera";
+			return {};
+		}
+
+		for (int c = 0; c < int(m_cameras.size()); c++)
+		{
+			if (plantImages[c].cols != m_cameras[c].silhouette.width() || plantImages[c].rows != m_cameras[c].silhouette.height())
+			{
+				qWarning() << "Pictures of plants must have the same size as pictures of cameras";
+				return {};
+			}
+		}
+	}
 
 	const auto start = std::chrono::high_resolution_clock::now();
 
+	std::vector<VoxelGrid> voxelGrids;
+	voxelGrids.reserve(numberPlants);
+	for (int p = 0; p < numberPlants; p++)
+	{
+		voxelGrids.emplace_back(m_voxelGrid.boundingBox(),
+		                        m_voxelGrid.resolutionX(),
+		                        m_voxelGrid.resolutionY(),
+		                        m_voxelGrid.resolutionZ(),
+		                        m_voxelGrid.storage());
+	}
+
+	if (numberPlants == 0)
+	{
+		return voxelGrids;
+	}
+
+	const auto allLanes = numberPlants == maximumNumberPlants
+	                    ? ~std::uint64_t(0)
+	                    : (std::uint64_t(1) << numberPlants) - 1;
+
+	std::vector<BatchSilhouettes> batchSilhouettes(m_cameras.size());
+	std::vector<SilhouettePyramids> silhouettePyramids(m_cameras.size());
+	for (int c = 0; c < int(m_cameras.size()); c++)
+	{
+		batchSilhouettes[c] = computeBatchSilhouettes(c, images, silhouettePyramids[c]);
+	}
+
+	// Root cells are processed independently by threads
+	const auto rootCells = splitInCells(32);
+
 	// Add voxels from each threads in a separate list to avoid critical sections
-	std::vector<std::vector<Voxel>> voxels(omp_get_max_threads());
-	// Reserve some memory to avoid too many re-allocations
-	for (auto v : voxels)
+	std::vector<std::vector<std::pair<Voxel, std::uint64_t>>> threadVoxels(omp_get_max_threads());
+
+	#pragma omp parallel
 	{
-		v.reserve(m_voxelGrid.resolutionX());
+		ColumnBuffers buffers;
+
+		// Most root cells are empty, dynamic scheduling balances the remaining work
+		#pragma omp for schedule(dynamic)
+		for (int i = 0; i < int(rootCells.size()); i++)
+		{
+			carveBatchCell(rootCells[i], m_cameraOrder, silhouettePyramids, batchSilhouettes, allLanes, buffers, threadVoxels[omp_get_thread_num()]);
+		}
 	}
 
-	#pragma omp parallel for schedule(static)
-	for (int x = 0; x < m_voxelGrid.resolutionX(); x++)
+	// Dispatch voxels to the plants they belong to
+	std::vector<std::vector<Voxel>> plantVoxels(numberPlants);
+	for (const auto& v : threadVoxels)
+	{
+		for (const auto& voxel : v)
+		{
+			for (int p = 0; p < numberPlants; p++)
+			{
+				if (voxel.second & (std::uint64_t(1) << p))
+				{
+					plantVoxels[p].push_back(voxel.first);
+				}
+			}
+		}
+	}
+
+	// Cells are carved in any order, voxels are sorted in linear time before filling the grids
+	for (int p = 0; p < numberPlants; p++)
+	{
+		sortVoxels(plantVoxels[p]);
+
+		voxelGrids[p].setVoxels(std::move(plantVoxels[p]));
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	const double elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+	qInfo() << "Voxel carving time for" << numberPlants << "plants: " << elapsedTime << " ms";
+
+	return voxelGrids;
+}
+
+VoxelCarver::BatchSilhouettes VoxelCarver::computeBatchSilhouettes(
+	int camera,
+	const std::vector<std::vector<cv::Mat>>& images,
+	SilhouettePyramids& silhouettePyramids) const
+{
+	const auto& cameraImage = m_cameras[camera];
+	const auto width = cameraImage.silhouette.width();
+	const auto height = cameraImage.silhouette.height();
+
+	const auto numberPlants = int(images.size());
+
+	std::vector<SilhouetteMask> silhouettes;
+	silhouettes.reserve(numberPlants);
+	for (int p = 0; p < numberPlants; p++)
+	{
+		silhouettes.push_back(computeSilhouette(images[p][camera]));
+	}
+
+	BatchSilhouettes batchSilhouettes;
+
+	// The smallest word holding a bit per plant
+	while (batchSilhouettes.laneBytes > 1 && numberPlants <= 4 * batchSilhouettes.laneBytes)
+	{
+		batchSilhouettes.laneBytes /= 2;
+	}
+
+	// Interleave the masks of plants in the bits of the lanes
+	const auto interleave = [width, height, numberPlants, &batchSilhouettes](const std::vector<SilhouetteMask>& masks, std::vector<unsigned char>& lanes)
 	{
-		for (int y = 0; y < m_voxelGrid.resolutionY(); y++)
+		lanes.assign(std::size_t(width) * height * batchSilhouettes.laneBytes, 0);
+
+		#pragma omp parallel
 		{
-			for (int z = 0; z < m_voxelGrid.resolutionZ(); z++)
+			// Words of a row are gathered in full width before being narrowed
+			std::vector<std::uint64_t> row(width);
+
+			#pragma omp for
+			for (int y = 0; y < height; y++)
 			{
-				const auto point = m_voxelGrid.voxel(x, y ,z);
+				std::fill(row.begin(), row.end(), 0);
 
-				if (isInside(point))
+				for (int p = 0; p < numberPlants; p++)
 				{
-					const auto currentThread = omp_get_thread_num();
-					voxels[currentThread].emplace_back(x, y, z);
+					const auto lane = std::uint64_t(1) << p;
+
+					for (int w = 0; w < masks[p].wordsPerRow(); w++)
+					{
+						// Most of the picture is background, skip empty words
+						const auto bits = masks[p].word(w, y);
+						if (bits == 0)
+						{
+							continue;
+						}
+
+						for (int b = 0; b < 64; b++)
+						{
+							if ((bits >> b) & 1)
+							{
+								row[w * 64 + b] |= lane;
+							}
+						}
+					}
+				}
+
+				for (int x = 0; x < width; x++)
+				{
+					batchSilhouettes.store(lanes, std::size_t(y) * width + x, row[x]);
 				}
 			}
 		}
+	};
+
+	interleave(silhouettes, batchSilhouettes.lanes);
+
+	batchSilhouettes.dilatedLanes.resize(cameraImage.dilatedSilhouettes.size());
+	for (int i = 0; i < int(cameraImage.dilatedSilhouettes.size()); i++)
+	{
+		std::vector<SilhouetteMask> dilatedSilhouettes;
+		dilatedSilhouettes.reserve(numberPlants);
+		for (const auto& silhouette : silhouettes)
+		{
+			dilatedSilhouettes.push_back(silhouette.dilated(cameraImage.minimumOffset + i));
+		}
+
+		interleave(dilatedSilhouettes, batchSilhouettes.dilatedLanes[i]);
 	}
 
-	// Add all the voxels from the sub lists to the grid
-	for (const auto& threadVoxels : voxels)
+	const auto allLanes = numberPlants == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << numberPlants) - 1;
+
+	// A cell is outside if it is outside every plant, and inside if it is inside every plant
+	SilhouetteMask anyPlant(width, height);
+	SilhouetteMask allPlants(width, height);
+
+	#pragma omp parallel for
+	for (int y = 0; y < height; y++)
 	{
-		for (const auto& voxel : threadVoxels)
+		for (int x = 0; x < width; x++)
 		{
-			m_voxelGrid.add(voxel.x, voxel.y, voxel.z);
+			const auto index = std::size_t(y) * width + x;
+
+			if (batchSilhouettes.load(batchSilhouettes.dilatedLanes.back(), index) != 0)
+			{
+				anyPlant.set(x, y);
+			}
+
+			if (batchSilhouettes.load(batchSilhouettes.dilatedLanes.front(), index) == allLanes)
+			{
+				allPlants.set(x, y);
+			}
 		}
 	}
 
-	const auto end = std::chrono::high_resolution_clock::now();
+	silhouettePyramids.minimumOffset = OccupancyPyramid(allPlants);
+	silhouettePyramids.maximumOffset = OccupancyPyramid(anyPlant);
 
-	// Calculating total time taken by the program. 
-	const double elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	return batchSilhouettes;
+}
 
-	qInfo() << "Voxel carving time: " << elapsedTime << " ms";
+void VoxelCarver::updateCameraOrder()
+{
+	// Number of samples along each axis of the voxel grid
+	const int sampleResolution = 16;
 
-	m_voxelGrid.sortVoxels();
+	const auto stepX = std::max(m_voxelGrid.resolutionX() / sampleResolution, 1);
+	const auto stepY = std::max(m_voxelGrid.resolutionY() / sampleResolution, 1);
+	const auto stepZ = std::max(m_voxelGrid.resolutionZ() / sampleResolution, 1);
 
-	m_voxelGridReady = true;
+	const auto samplesX = (m_voxelGrid.resolutionX() + stepX - 1) / stepX;
+	const auto samplesY = (m_voxelGrid.resolutionY() + stepY - 1) / stepY;
+	const auto samplesZ = (m_voxelGrid.resolutionZ() + stepZ - 1) / stepZ;
+	const auto numberSamples = samplesX * samplesY * samplesZ;
+
+	const auto numberCameras = int(m_cameras.size());
+
+	// Every camera is tested on every sample to measure its selectivity independently of the others
+	std::vector<unsigned char> visibilities(std::size_t(numberSamples) * numberCameras);
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < samplesX; i++)
+	{
+		for (int j = 0; j < samplesY; j++)
+		{
+			for (int k = 0; k < samplesZ; k++)
+			{
+				const auto point = m_voxelGrid.voxel(i * stepX, j * stepY, k * stepZ);
+				const auto sample = (std::size_t(i) * samplesY + j) * samplesZ + k;
+
+				for (int c = 0; c < numberCameras; c++)
+				{
+					visibilities[sample * numberCameras + c] = isVisibleFromCamera(m_cameras[c], point) ? 1 : 0;
+				}
+			}
+		}
+	}
+
+	m_cameraRejectionRates.assign(numberCameras, 0.0f);
+	for (int sample = 0; sample < numberSamples; sample++)
+	{
+		for (int c = 0; c < numberCameras; c++)
+		{
+			if (!visibilities[std::size_t(sample) * numberCameras + c])
+			{
+				m_cameraRejectionRates[c] += 1.0f;
+			}
+		}
+	}
+
+	for (auto& rate : m_cameraRejectionRates)
+	{
+		rate /= float(std::max(numberSamples, 1));
+	}
+
+	std::vector<int> insertionOrder(numberCameras);
+	for (int c = 0; c < numberCameras; c++)
+	{
+		insertionOrder[c] = c;
+	}
+
+	// Cameras are redundant, the next camera is the one rejecting most of the samples accepted by previous cameras
+	std::vector<int> remainingSamples(numberSamples);
+	for (int sample = 0; sample < numberSamples; sample++)
+	{
+		remainingSamples[sample] = sample;
+	}
+
+	std::vector<bool> orderedCameras(numberCameras, false);
+	m_cameraOrder.clear();
+
+	while (int(m_cameraOrder.size()) < numberCameras)
+	{
+		// Ties keep the insertion order
+		int bestCamera = -1;
+		int bestRejections = -1;
+		for (int c = 0; c < numberCameras; c++)
+		{
+			if (orderedCameras[c])
+			{
+				continue;
+			}
+
+			int rejections = 0;
+			for (const auto sample : remainingSamples)
+			{
+				if (!visibilities[std::size_t(sample) * numberCameras + c])
+				{
+					rejections++;
+				}
+			}
+
+			if (rejections > bestRejections)
+			{
+				bestCamera = c;
+				bestRejections = rejections;
+			}
+		}
+
+		m_cameraOrder.push_back(bestCamera);
+		orderedCameras[bestCamera] = true;
+
+		// Only samples accepted by this camera are tested by the next ones
+		remainingSamples.erase(std::remove_if(remainingSamples.begin(), remainingSamples.end(), [&](int sample)
+		{
+			return !visibilities[std::size_t(sample) * numberCameras + bestCamera];
+		}), remainingSamples.end());
+	}
+
+	// Average number of cameras tested before a sample is rejected
+	const auto averageTests = [&](const std::vector<int>& order)
+	{
+		long long tests = 0;
+		for (int sample = 0; sample < numberSamples; sample++)
+		{
+			for (const auto c : order)
+			{
+				tests++;
+
+				if (!visibilities[std::size_t(sample) * numberCameras + c])
+				{
+					break;
+				}
+			}
+		}
+
+		return double(tests) / double(std::max(numberSamples, 1));
+	};
+
+	for (int c = 0; c < numberCameras; c++)
+	{
+		qDebug() << "Camera" << c << "rejection rate:" << m_cameraRejectionRates[c];
+	}
+
+	qDebug() << "Camera tests per voxel:" << averageTests(insertionOrder)
+	         << "in insertion order," << averageTests(m_cameraOrder) << "in adaptive order";
+}
+
+VoxelCarver::VoxelCell VoxelCarver::computeCarvingDomain() const
+{
+	const auto& boundingBox = m_voxelGrid.boundingBox();
+
+	// Box containing the centers of voxels that may be visible from all cameras
+	QVector3D minimum(boundingBox.minX(), boundingBox.minY(), boundingBox.minZ());
+	QVector3D maximum(boundingBox.maxX(), boundingBox.maxY(), boundingBox.maxZ());
+
+	const VoxelCell emptyDomain(0, 0, 0, 0, 0, 0);
+
+	// The box shrinks with each camera, cameras that could not bound it at first may bound it at the second pass
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (const auto& cameraImage : m_cameras)
+		{
+			const auto width = cameraImage.silhouette.width();
+			const auto height = cameraImage.silhouette.height();
+
+			// Largest neighborhood around voxels, with a margin of one pixel for rounding
+			const auto margin = cameraImage.minimumOffset + int(cameraImage.dilatedSilhouettes.size());
+
+			const auto viewDirection = cameraImage.camera.at() - cameraImage.camera.eye();
+
+			// Neighborhoods of all voxels must be in the image, otherwise voxels may be visible out of the silhouette
+			// The projection of the box is the convex hull of the projection of its corners
+			auto boxInImage = true;
+			for (int i = 0; i < 8 && boxInImage; i++)
+			{
+				const QVector3D point((i & 1) ? maximum.x() : minimum.x(),
+				                      (i & 2) ? maximum.y() : minimum.y(),
+				                      (i & 4) ? maximum.z() : minimum.z());
+
+				const auto realPixel = cameraImage.projection.project(point);
+				const auto x = realPixel.x() + float(cameraImage.offsetX);
+				const auto y = realPixel.y() + float(cameraImage.offsetY);
+
+				boxInImage = QVector3D::dotProduct(point - cameraImage.camera.eye(), viewDirection) > 0.0f
+				          && realPixel.x() >= 0.0f
+				          && x - float(margin) >= 0.0f && x + float(margin) <= float(width - 1)
+				          && y - float(margin) >= 0.0f && y + float(margin) <= float(height - 1);
+			}
+
+			if (!boxInImage)
+			{
+				continue;
+			}
+
+			int minPixelX;
+			int minPixelY;
+			int maxPixelX;
+			int maxPixelY;
+			if (!cameraImage.silhouette.boundingRectangle(minPixelX, minPixelY, maxPixelX, maxPixelY))
+			{
+				// The object is not seen by this camera
+				return emptyDomain;
+			}
+
+			// Real coordinates of pixels whose neighborhood may contain a pixel of the silhouette
+			const auto left = float(minPixelX - margin - cameraImage.offsetX) - 0.5f;
+			const auto right = float(maxPixelX + margin - cameraImage.offsetX) + 0.5f;
+			const auto top = float(minPixelY - margin - cameraImage.offsetY) - 0.5f;
+			const auto bottom = float(maxPixelY + margin - cameraImage.offsetY) + 0.5f;
+
+			// Same in Normalized Device Coordinates, with an inverted Y axis
+			const auto halfWidth = float(width) / 2.0f;
+			const auto halfHeight = float(height) / 2.0f;
+			const auto clipLeft = (left - halfWidth) / halfWidth;
+			const auto clipRight = (right - halfWidth) / halfWidth;
+			const auto clipTop = (halfHeight - top) / halfHeight;
+			const auto clipBottom = (halfHeight - bottom) / halfHeight;
+
+			// Rows of the transformation in homogeneous coordinates, points of the box are in front of the camera (w > 0)
+			const auto transformation = cameraImage.camera.projectionMatrix() * cameraImage.camera.viewMatrix();
+			const auto rowX = transformation.row(0);
+			const auto rowY = transformation.row(1);
+			const auto rowW = transformation.row(3);
+
+			// Sides of the frustum of the bounding rectangle
+			const std::vector<QVector4D> planes = {
+				rowX - clipLeft * rowW,
+				clipRight * rowW - rowX,
+				rowY - clipBottom * rowW,
+				clipTop * rowW - rowY
+			};
+
+			if (!clipBox(minimum, maximum, planes))
+			{
+				return emptyDomain;
+			}
+		}
+	}
+
+	// Voxels whose center is in the box, with a margin of one voxel for rounding
+	const auto start = boundingBox.inverseLerp(minimum);
+	const auto end = boundingBox.inverseLerp(maximum);
+
+	const auto startVoxel = [](float t, int resolution)
+	{
+		return clamp(int(std::ceil(t * float(resolution - 1))) - 1, 0, resolution);
+	};
+
+	const auto endVoxel = [](float t, int resolution)
+	{
+		return clamp(int(std::floor(t * float(resolution - 1))) + 2, 0, resolution);
+	};
+
+	return VoxelCell(startVoxel(start.x(), m_voxelGrid.resolutionX()),
+	                 startVoxel(start.y(), m_voxelGrid.resolutionY()),
+	                 startVoxel(start.z(), m_voxelGrid.resolutionZ()),
+	                 endVoxel(end.x(), m_voxelGrid.resolutionX()),
+	                 endVoxel(end.y(), m_voxelGrid.resolutionY()),
+	                 endVoxel(end.z(), m_voxelGrid.resolutionZ()));
+}
+
+template<typename ThreadBuffers, typename CarveTile>
+void VoxelCarver::carveTiles(const VoxelCell& domain, CarveTile carveTile, std::vector<Voxel>& voxels) const
+{
+	// Number of columns of a tile along X and Y, the voxels of a tile fit in cache
+	const int tileSize = 32;
+
+	const auto resolutionX = m_voxelGrid.resolutionX();
+	const auto resolutionY = m_voxelGrid.resolutionY();
+
+	const auto tilesX = (std::max(domain.sizeX(), 0) + tileSize - 1) / tileSize;
+	const auto tilesY = (std::max(domain.sizeY(), 0) + tileSize - 1) / tileSize;
+	const auto numberTiles = (domain.sizeZ() > 0) ? tilesX * tilesY : 0;
+
+	std::vector<std::vector<Voxel>> tileVoxels(numberTiles);
+
+	// Number of voxels of each column, then index of the first voxel of each column in the output
+	std::vector<std::size_t> columnOffsets(std::size_t(resolutionX) * resolutionY + 1, 0);
+
+	#pragma omp parallel
+	{
+		ThreadBuffers buffers;
+
+		// Most tiles are empty, idle threads take the next tile to balance the remaining work
+		#pragma omp for schedule(dynamic)
+		for (int t = 0; t < numberTiles; t++)
+		{
+			const auto startX = domain.startX + (t / tilesY) * tileSize;
+			const auto startY = domain.startY + (t % tilesY) * tileSize;
+
+			const VoxelCell tile(startX, startY, domain.startZ,
+			                     std::min(startX + tileSize, domain.endX),
+			                     std::min(startY + tileSize, domain.endY),
+			                     domain.endZ);
+
+			carveTile(tile, buffers, tileVoxels[t]);
+
+			// Columns belong to a single tile, counts are not shared between threads
+			for (const auto& voxel : tileVoxels[t])
+			{
+				columnOffsets[std::size_t(voxel.x) * resolutionY + voxel.y + 1]++;
+			}
+		}
+	}
+
+	// Sorted voxels are ordered by column, then by Z
+	for (std::size_t i = 1; i < columnOffsets.size(); i++)
+	{
+		columnOffsets[i] += columnOffsets[i - 1];
+	}
+
+	voxels.resize(columnOffsets.back());
+
+	// Copy each tile at its place in the output and release it
+	#pragma omp parallel for schedule(dynamic)
+	for (int t = 0; t < numberTiles; t++)
+	{
+		for (const auto& voxel : tileVoxels[t])
+		{
+			voxels[columnOffsets[std::size_t(voxel.x) * resolutionY + voxel.y]++] = voxel;
+		}
+
+		std::vector<Voxel>().swap(tileVoxels[t]);
+	}
+}
+
+std::vector<VoxelCarver::VoxelCell> VoxelCarver::splitInCells(int cellSize) const
+{
+	std::vector<VoxelCell> cells;
+
+	for (int x = 0; x < m_voxelGrid.resolutionX(); x += cellSize)
+	{
+		for (int y = 0; y < m_voxelGrid.resolutionY(); y += cellSize)
+		{
+			for (int z = 0; z < m_voxelGrid.resolutionZ(); z += cellSize)
+			{
+				cells.emplace_back(x, y, z,
+				                   std::min(x + cellSize, m_voxelGrid.resolutionX()),
+				                   std::min(y + cellSize, m_voxelGrid.resolutionY()),
+				                   std::min(z + cellSize, m_voxelGrid.resolutionZ()));
+			}
+		}
+	}
+
+	return cells;
+}
+
+std::vector<VoxelCarver::VoxelCell> VoxelCarver::subdivideCell(const VoxelCell& cell)
+{
+	const auto middleX = cell.startX + (cell.sizeX() + 1) / 2;
+	const auto middleY = cell.startY + (cell.sizeY() + 1) / 2;
+	const auto middleZ = cell.startZ + (cell.sizeZ() + 1) / 2;
+
+	const std::array<std::pair<int, int>, 2> rangesX = { { {cell.startX, middleX}, {middleX, cell.endX} } };
+	const std::array<std::pair<int, int>, 2> rangesY = { { {cell.startY, middleY}, {middleY, cell.endY} } };
+	const std::array<std::pair<int, int>, 2> rangesZ = { { {cell.startZ, middleZ}, {middleZ, cell.endZ} } };
+
+	std::vector<VoxelCell> children;
+	children.reserve(8);
+
+	for (const auto& rangeX : rangesX)
+	{
+		for (const auto& rangeY : rangesY)
+		{
+			for (const auto& rangeZ : rangesZ)
+			{
+				// Skip empty children when the cell is flat along an axis
+				if (rangeX.first < rangeX.second && rangeY.first < rangeY.second && rangeZ.first < rangeZ.second)
+				{
+					children.emplace_back(rangeX.first, rangeY.first, rangeZ.first,
+					                      rangeX.second, rangeY.second, rangeZ.second);
+				}
+			}
+		}
+	}
+
+	return children;
+}
+
+void VoxelCarver::processExhaustive(const VoxelCell& domain, std::vector<Voxel>& voxels) const
+{
+	carveTiles<ColumnBuffers>(domain, [this](const VoxelCell& tile, ColumnBuffers& buffers, std::vector<Voxel>& tileVoxels)
+	{
+		for (int x = tile.startX; x < tile.endX; x++)
+		{
+			for (int y = tile.startY; y < tile.endY; y++)
+			{
+				carveColumn(x, y, tile.startZ, tile.endZ, m_cameraOrder, buffers, tileVoxels);
+			}
+		}
+	}, voxels);
+}
+
+void VoxelCarver::processHierarchical(const VoxelCell& domain, std::vector<Voxel>& voxels) const
+{
+	// Size of the root cells along Z, a tile is a stack of root cells
+	const int rootCellSize = 32;
+
+	carveTiles<ColumnBuffers>(domain, [&](const VoxelCell& tile, ColumnBuffers& buffers, std::vector<Voxel>& tileVoxels)
+	{
+		// Root cells are processed by increasing Z, so that voxels of each column are sorted
+		for (int z = tile.startZ; z < tile.endZ; z += rootCellSize)
+		{
+			const VoxelCell rootCell(tile.startX, tile.startY, z,
+			                         tile.endX, tile.endY, std::min(z + rootCellSize, tile.endZ));
+
+			carveCell(rootCell, m_cameraOrder, buffers, tileVoxels);
+		}
+	}, voxels);
+}
+
+void VoxelCarver::carveColumn(
+	int x, int y, int startZ, int endZ,
+	const std::vector<int>& cameras,
+	ColumnBuffers& buffers,
+	std::vector<Voxel>& voxels) const
+{
+	const auto count = endZ - startZ;
+
+	buffers.pointsX.resize(count);
+	buffers.pointsY.resize(count);
+	buffers.pointsZ.resize(count);
+	buffers.diagonalsX.resize(count);
+	buffers.diagonalsY.resize(count);
+	buffers.diagonalsZ.resize(count);
+	buffers.pixelsX.resize(count);
+	buffers.pixelsY.resize(count);
+	buffers.diagonalPixelsX.resize(count);
+	buffers.diagonalPixelsY.resize(count);
+	buffers.inside.assign(count, 1);
+
+	// Voxels of the column in struct of arrays form
+	for (int i = 0; i < count; i++)
+	{
+		const auto point = m_voxelGrid.voxel(x, y, startZ + i);
+
+		buffers.pointsX[i] = point.x();
+		buffers.pointsY[i] = point.y();
+		buffers.pointsZ[i] = point.z();
+	}
+
+	auto remaining = count;
+
+	for (int c = 0; c < int(cameras.size()) && remaining > 0; c++)
+	{
+		const auto& cameraImage = m_cameras[cameras[c]];
+
+		// Diagonal points in the image plane
+		for (int i = 0; i < count; i++)
+		{
+			buffers.diagonalsX[i] = buffers.pointsX[i] + cameraImage.diagonal.x();
+			buffers.diagonalsY[i] = buffers.pointsY[i] + cameraImage.diagonal.y();
+			buffers.diagonalsZ[i] = buffers.pointsZ[i] + cameraImage.diagonal.z();
+		}
+
+		cameraImage.projection.project(buffers.pointsX.data(),
+		                               buffers.pointsY.data(),
+		                               buffers.pointsZ.data(),
+		                               count,
+		                               buffers.pixelsX.data(),
+		                               buffers.pixelsY.data());
+
+		cameraImage.projection.project(buffers.diagonalsX.data(),
+		                               buffers.diagonalsY.data(),
+		                               buffers.diagonalsZ.data(),
+		                               count,
+		                               buffers.diagonalPixelsX.data(),
+		                               buffers.diagonalPixelsY.data());
+
+		for (int i = 0; i < count; i++)
+		{
+			// The voxel is not visible from this camera, therefore it is not part of the object
+			if (buffers.inside[i] && !isVisibleFromCamera(cameraImage,
+			                                              QVector2D(buffers.pixelsX[i], buffers.pixelsY[i]),
+			                                              QVector2D(buffers.diagonalPixelsX[i], buffers.diagonalPixelsY[i])))
+			{
+				buffers.inside[i] = 0;
+				remaining--;
+			}
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (buffers.inside[i])
+		{
+			voxels.emplace_back(x, y, startZ + i);
+		}
+	}
+}
+
+void VoxelCarver::carveCell(
+	const VoxelCell& cell,
+	const std::vector<int>& activeCameras,
+	ColumnBuffers& buffers,
+	std::vector<Voxel>& voxels) const
+{
+	// Below this size, voxels are directly tested against cameras
+	const int leafCellSize = 4;
+
+	const auto isLeaf = cell.sizeX() <= leafCellSize
+	                 && cell.sizeY() <= leafCellSize
+	                 && cell.sizeZ() <= leafCellSize;
+	
+	// Cameras for which the cell straddles the silhouette
+	std::vector<int> partialCameras;
+	partialCameras.reserve(activeCameras.size());
+
+	for (const auto c : activeCameras)
+	{
+		const auto visibility = classifyCell(m_cameras[c], m_cameras[c].pyramids, cell);
+		
+		if (visibility == CellVisibility::Outside)
+		{
+			// No voxel of this cell is part of the object
+			return;
+		}
+		
+		if (visibility == CellVisibility::Partial)
+		{
+			partialCameras.push_back(c);
+		}
+	}
+
+	// The cell is fully inside the silhouette of all cameras, or it is small enough
+	if (partialCameras.empty() || isLeaf)
+	{
+		for (int x = cell.startX; x < cell.endX; x++)
+		{
+			for (int y = cell.startY; y < cell.endY; y++)
+			{
+				carveColumn(x, y, cell.startZ, cell.endZ, partialCameras, buffers, voxels);
+			}
+		}
+
+		return;
+	}
+
+	// Subdivide the cell in at most 8 children
+	for (const auto& child : subdivideCell(cell))
+	{
+		carveCell(child, partialCameras, buffers, voxels);
+	}
+}
+
+void VoxelCarver::carveBatchColumn(
+	int x, int y, int startZ, int endZ,
+	const std::vector<int>& cameras,
+	const std::vector<BatchSilhouettes>& batchSilhouettes,
+	std::uint64_t allLanes,
+	ColumnBuffers& buffers,
+	std::vector<std::pair<Voxel, std::uint64_t>>& voxels) const
+{
+	const auto count = endZ - startZ;
+
+	buffers.pointsX.resize(count);
+	buffers.pointsY.resize(count);
+	buffers.pointsZ.resize(count);
+	buffers.diagonalsX.resize(count);
+	buffers.diagonalsY.resize(count);
+	buffers.diagonalsZ.resize(count);
+	buffers.pixelsX.resize(count);
+	buffers.pixelsY.resize(count);
+	buffers.diagonalPixelsX.resize(count);
+	buffers.diagonalPixelsY.resize(count);
+	buffers.lanes.assign(count, allLanes);
+
+	// Voxels of the column in struct of arrays form
+	for (int i = 0; i < count; i++)
+	{
+		const auto point = m_voxelGrid.voxel(x, y, startZ + i);
+
+		buffers.pointsX[i] = point.x();
+		buffers.pointsY[i] = point.y();
+		buffers.pointsZ[i] = point.z();
+	}
+
+	auto remaining = count;
+
+	for (int c = 0; c < int(cameras.size()) && remaining > 0; c++)
+	{
+		const auto& cameraImage = m_cameras[cameras[c]];
+
+		// Diagonal points in the image plane
+		for (int i = 0; i < count; i++)
+		{
+			buffers.diagonalsX[i] = buffers.pointsX[i] + cameraImage.diagonal.x();
+			buffers.diagonalsY[i] = buffers.pointsY[i] + cameraImage.diagonal.y();
+			buffers.diagonalsZ[i] = buffers.pointsZ[i] + cameraImage.diagonal.z();
+		}
+
+		// Projections are shared by all plants
+		cameraImage.projection.project(buffers.pointsX.data(),
+		                               buffers.pointsY.data(),
+		                               buffers.pointsZ.data(),
+		                               count,
+		                               buffers.pixelsX.data(),
+		                               buffers.pixelsY.data());
+
+		cameraImage.projection.project(buffers.diagonalsX.data(),
+		                               buffers.diagonalsY.data(),
+		                               buffers.diagonalsZ.data(),
+		                               count,
+		                               buffers.diagonalPixelsX.data(),
+		                               buffers.diagonalPixelsY.data());
+
+		for (int i = 0; i < count; i++)
+		{
+			if (buffers.lanes[i] != 0)
+			{
+				// The voxel is only kept for plants in which it is visible from this camera
+				buffers.lanes[i] &= visibleLanesFromCamera(cameraImage,
+				                                           batchSilhouettes[cameras[c]],
+				                                           QVector2D(buffers.pixelsX[i], buffers.pixelsY[i]),
+				                                           QVector2D(buffers.diagonalPixelsX[i], buffers.diagonalPixelsY[i]));
+
+				if (buffers.lanes[i] == 0)
+				{
+					remaining--;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (buffers.lanes[i] != 0)
+		{
+			voxels.emplace_back(Voxel(x, y, startZ + i), buffers.lanes[i]);
+		}
+	}
+}
+
+void VoxelCarver::carveBatchCell(
+	const VoxelCell& cell,
+	const std::vector<int>& activeCameras,
+	const std::vector<SilhouettePyramids>& silhouettePyramids,
+	const std::vector<BatchSilhouettes>& batchSilhouettes,
+	std::uint64_t allLanes,
+	ColumnBuffers& buffers,
+	std::vector<std::pair<Voxel, std::uint64_t>>& voxels) const
+{
+	// Below this size, voxels are directly tested against cameras
+	const int leafCellSize = 4;
+
+	const auto isLeaf = cell.sizeX() <= leafCellSize
+	                 && cell.sizeY() <= leafCellSize
+	                 && cell.sizeZ() <= leafCellSize;
+
+	// Cameras for which the cell straddles the silhouette of at least one plant
+	std::vector<int> partialCameras;
+	partialCameras.reserve(activeCameras.size());
+
+	for (const auto c : activeCameras)
+	{
+		const auto visibility = classifyCell(m_cameras[c], silhouettePyramids[c], cell);
+
+		if (visibility == CellVisibility::Outside)
+		{
+			// No voxel of this cell is part of any plant
+			return;
+		}
+
+		if (visibility == CellVisibility::Partial)
+		{
+			partialCameras.push_back(c);
+		}
+	}
+
+	// The cell is fully inside the silhouettes of all plants for all cameras, or it is small enough
+	if (partialCameras.empty() || isLeaf)
+	{
+		for (int x = cell.startX; x < cell.endX; x++)
+		{
+			for (int y = cell.startY; y < cell.endY; y++)
+			{
+				carveBatchColumn(x, y, cell.startZ, cell.endZ, partialCameras, batchSilhouettes, allLanes, buffers, voxels);
+			}
+		}
+
+		return;
+	}
+
+	// Subdivide the cell in at most 8 children
+	for (const auto& child : subdivideCell(cell))
+	{
+		carveBatchCell(child, partialCameras, silhouettePyramids, batchSilhouettes, allLanes, buffers, voxels);
+	}
+}
+
+void VoxelCarver::processColumnIntervals(const VoxelCell& domain, std::vector<Voxel>& voxels) const
+{
+	// Projections of the columns on cameras, shared between plants through the cache
+	ProjectionCache projectionCache;
+	loadColumnSpans(projectionCache);
+
+	// Cameras seeing voxel columns as pixel columns are the cheapest, they are processed first
+	std::vector<int> cameraOrder;
+	for (const auto c : m_cameraOrder)
+	{
+		if (m_cameras[c].verticalColumns)
+		{
+			cameraOrder.push_back(c);
+		}
+	}
+
+	for (const auto c : m_cameraOrder)
+	{
+		if (!m_cameras[c].verticalColumns)
+		{
+			cameraOrder.push_back(c);
+		}
+	}
+
+	carveTiles<IntervalBuffers>(domain, [&](const VoxelCell& tile, IntervalBuffers& buffers, std::vector<Voxel>& tileVoxels)
+	{
+		auto& intervals = buffers.intervals;
+		auto& visibleIntervals = buffers.visibleIntervals;
+
+		for (int x = tile.startX; x < tile.endX; x++)
+		{
+			for (int y = tile.startY; y < tile.endY; y++)
+			{
+				// At the beginning, the whole column is in the object
+				intervals.assign(1, std::make_pair(tile.startZ, tile.endZ));
+
+				for (int i = 0; i < int(cameraOrder.size()) && !intervals.empty(); i++)
+				{
+					const auto c = cameraOrder[i];
+
+					visibleIntervals.clear();
+
+					if (m_cameras[c].verticalColumns)
+					{
+						const auto& span = projectionCache.span(columnSpanIndex(c, x, y));
+						carveVerticalColumn(m_cameras[c], span, x, y, intervals, visibleIntervals);
+					}
+					else
+					{
+						carveColumnIntervals(m_cameras[c], x, y, intervals, visibleIntervals);
+					}
+
+					std::swap(intervals, visibleIntervals);
+				}
+
+				for (const auto& interval : intervals)
+				{
+					for (int z = interval.first; z < interval.second; z++)
+					{
+						tileVoxels.emplace_back(x, y, z);
+					}
+				}
+			}
+		}
+	}, voxels);
+}
+
+void VoxelCarver::processIncremental(const VoxelCell& domain, std::vector<Voxel>& voxels)
+{
+	const auto numberCameras = int(m_cameras.size());
+
+	if (m_incrementalVoxelGridValid)
+	{
+		// Added cameras can only reject voxels that are already in the grid
+		const auto& gridVoxels = m_voxelGrid.voxels();
+
+		// Voxels of the grid are sorted, each slab along X is a range of the list and keeps its order
+		std::vector<std::vector<Voxel>> slabVoxels(m_voxelGrid.resolutionX());
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int x = 0; x < m_voxelGrid.resolutionX(); x++)
+		{
+			const auto first = std::lower_bound(gridVoxels.begin(), gridVoxels.end(), Voxel(x, 0, 0));
+			const auto last = std::lower_bound(first, gridVoxels.end(), Voxel(x + 1, 0, 0));
+
+			for (auto it = first; it != last; ++it)
+			{
+				const auto point = m_voxelGrid.voxel(*it);
+
+				auto inside = true;
+				for (int c = m_numberCarvedCameras; c < numberCameras && inside; c++)
+				{
+					inside = isVisibleFromCamera(m_cameras[c], point);
+				}
+
+				if (inside)
+				{
+					slabVoxels[x].push_back(*it);
+				}
+			}
+		}
+
+		for (const auto& v : slabVoxels)
+		{
+			voxels.insert(voxels.end(), v.begin(), v.end());
+		}
+	}
+	else if (m_visibilityCounts.empty())
+	{
+		// No camera has been removed, the grid is carved from scratch
+		processHierarchical(domain, voxels);
+	}
+	else
+	{
+		// Counts are stored on 8 bits
+		if (numberCameras > std::numeric_limits<unsigned char>::max())
+		{
+			qWarning() << "Too many cameras for incremental carving, the voxel grid is carved from scratch";
+			resetVisibilityCounts();
+			processHierarchical(domain, voxels);
+			return;
+		}
+
+		for (int c = 0; c < numberCameras; c++)
+		{
+			if (!m_countedCameras[c])
+			{
+				updateVisibilityCounts(c, 1);
+				m_countedCameras[c] = true;
+			}
+		}
+
+		// Look for voxels visible from all cameras in the whole grid, slabs along X are already sorted
+		std::vector<std::vector<Voxel>> slabVoxels(m_voxelGrid.resolutionX());
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int x = 0; x < m_voxelGrid.resolutionX(); x++)
+		{
+			for (int y = 0; y < m_voxelGrid.resolutionY(); y++)
+			{
+				const auto* counts = &m_visibilityCounts[m_voxelGrid.voxelIndex(x, y, 0)];
+
+				for (int z = 0; z < m_voxelGrid.resolutionZ(); z++)
+				{
+					if (counts[z] == numberCameras)
+					{
+						slabVoxels[x].emplace_back(x, y, z);
+					}
+				}
+			}
+		}
+
+		for (const auto& v : slabVoxels)
+		{
+			voxels.insert(voxels.end(), v.begin(), v.end());
+		}
+	}
+
+	m_incrementalVoxelGridValid = true;
+	m_numberCarvedCameras = numberCameras;
+}
+
+void VoxelCarver::updateVisibilityCounts(int camera, int increment)
+{
+	const auto& cameraImage = m_cameras[camera];
+
+	if (cameraImage.verticalColumns)
+	{
+		// Columns of voxels are intersected with the runs of pixels seen by the camera
+		#pragma omp parallel
+		{
+			ZIntervals intervals;
+			ZIntervals visibleIntervals;
+
+			#pragma omp for schedule(dynamic)
+			for (int x = 0; x < m_voxelGrid.resolutionX(); x++)
+			{
+				for (int y = 0; y < m_voxelGrid.resolutionY(); y++)
+				{
+					intervals.assign(1, std::make_pair(0, m_voxelGrid.resolutionZ()));
+					visibleIntervals.clear();
+
+					carveVerticalColumn(cameraImage, computeColumnSpan(cameraImage, x, y), x, y, intervals, visibleIntervals);
+
+					auto* counts = &m_visibilityCounts[m_voxelGrid.voxelIndex(x, y, 0)];
+					for (const auto& interval : visibleIntervals)
+					{
+						for (int z = interval.first; z < interval.second; z++)
+						{
+							counts[z] = static_cast<unsigned char>(counts[z] + increment);
+						}
+					}
+				}
+			}
+		}
+
+		return;
+	}
+
+	const auto rootCells = splitInCells(32);
+
+	#pragma omp parallel
+	{
+		ColumnBuffers buffers;
+		std::vector<Voxel> visibleVoxels;
+
+		// Cells do not overlap, each count is updated by a single thread
+		#pragma omp for schedule(dynamic)
+		for (int i = 0; i < int(rootCells.size()); i++)
+		{
+			countCell(rootCells[i], camera, increment, buffers, visibleVoxels);
+		}
+	}
+}
+
+void VoxelCarver::countCell(
+	const VoxelCell& cell,
+	int camera,
+	int increment,
+	ColumnBuffers& buffers,
+	std::vector<Voxel>& visibleVoxels)
+{
+	// Below this size, voxels are directly tested against the camera
+	const int leafCellSize = 4;
+
+	const auto visibility = classifyCell(m_cameras[camera], m_cameras[camera].pyramids, cell);
+
+	if (visibility == CellVisibility::Outside)
+	{
+		return;
+	}
+
+	if (visibility == CellVisibility::Inside)
+	{
+		// Every voxel of the cell is visible, columns are contiguous in the counts
+		for (int x = cell.startX; x < cell.endX; x++)
+		{
+			for (int y = cell.startY; y < cell.endY; y++)
+			{
+				auto* counts = &m_visibilityCounts[m_voxelGrid.voxelIndex(x, y, cell.startZ)];
+
+				for (int i = 0; i < cell.sizeZ(); i++)
+				{
+					counts[i] = static_cast<unsigned char>(counts[i] + increment);
+				}
+			}
+		}
+
+		return;
+	}
+
+	if (cell.sizeX() <= leafCellSize && cell.sizeY() <= leafCellSize && cell.sizeZ() <= leafCellSize)
+	{
+		const std::vector<int> cameras(1, camera);
+
+		visibleVoxels.clear();
+		for (int x = cell.startX; x < cell.endX; x++)
+		{
+			for (int y = cell.startY; y < cell.endY; y++)
+			{
+				carveColumn(x, y, cell.startZ, cell.endZ, cameras, buffers, visibleVoxels);
+			}
+		}
+
+		for (const auto& voxel : visibleVoxels)
+		{
+			auto& count = m_visibilityCounts[m_voxelGrid.voxelIndex(voxel.x, voxel.y, voxel.z)];
+			count = static_cast<unsigned char>(count + increment);
+		}
+
+		return;
+	}
+
+	// Subdivide the cell in at most 8 children
+	for (const auto& child : subdivideCell(cell))
+	{
+		countCell(child, camera, increment, buffers, visibleVoxels);
+	}
+}
+
+void VoxelCarver::resetVisibilityCounts()
+{
+	std::vector<unsigned char>().swap(m_visibilityCounts);
+	std::fill(m_countedCameras.begin(), m_countedCameras.end(), false);
+	m_incrementalVoxelGridValid = false;
+}
+
+ProjectionCache::ColumnSpan VoxelCarver::computeColumnSpan(const CameraImage& cameraImage, int x, int y) const
+{
+	const auto lastZ = m_voxelGrid.resolutionZ() - 1;
+
+	// Projections of both ends of the column
+	const auto bottom = m_voxelGrid.voxel(x, y, 0);
+	const auto top = m_voxelGrid.voxel(x, y, lastZ);
+	const auto bottomPixel = cameraImage.projection.project(bottom);
+	const auto topPixel = cameraImage.projection.project(top);
+	const auto bottomDiagonalPixel = cameraImage.projection.project(bottom + cameraImage.diagonal);
+	const auto topDiagonalPixel = cameraImage.projection.project(top + cameraImage.diagonal);
+
+	// Size of the neighborhood, constant along the column since the depth of voxels is constant
+	const auto offset = int(std::ceil(bottomPixel.distanceToPoint(bottomDiagonalPixel)));
+
+	const auto column = int(std::round(bottomPixel.x() + float(cameraImage.offsetX)));
+
+	ProjectionCache::ColumnSpan span;
+	span.pixelColumn = std::int16_t(clamp(column, -1, int(std::numeric_limits<std::int16_t>::max())));
+	span.offset = std::int16_t(std::min(offset, int(std::numeric_limits<std::int16_t>::max())));
+
+	// Rows of pixels vary linearly along the column
+	span.bottomRow = bottomPixel.y() + float(cameraImage.offsetY);
+	span.rowStep = lastZ > 0 ? (topPixel.y() - bottomPixel.y()) / float(lastZ) : 0.0f;
+
+	// The column must be in the frustum and project on a single column of pixels with the same neighborhood
+	if (lastZ == 0
+	 || bottomPixel.x() < 0.0f
+	 || topPixel.x() < 0.0f
+	 || column != int(std::round(topPixel.x() + float(cameraImage.offsetX)))
+	 || offset != int(std::ceil(topPixel.distanceToPoint(topDiagonalPixel))))
+	{
+		span.offset = -1;
+	}
+
+	return span;
+}
+
+void VoxelCarver::carveVerticalColumn(
+	const CameraImage& cameraImage,
+	const ProjectionCache::ColumnSpan& span,
+	int x, int y,
+	const ZIntervals& intervals,
+	ZIntervals& visibleIntervals) const
+{
+	const auto dilatedIndex = span.offset - cameraImage.minimumOffset;
+
+	if (span.offset < 0
+	 || dilatedIndex < 0
+	 || dilatedIndex >= int(cameraImage.dilatedColumnRuns.size()))
+	{
+		carveColumnVoxels(cameraImage, x, y, intervals, visibleIntervals);
+		return;
+	}
+
+	const int column = span.pixelColumn;
+
+	// If the column is not visible in the image, we consider it as present
+	if (column < 0 || column >= cameraImage.silhouette.width())
+	{
+		for (const auto& interval : intervals)
+		{
+			addInterval(visibleIntervals, interval.first, interval.second);
+		}
+
+		return;
+	}
+
+	const auto& runs = cameraImage.dilatedColumnRuns[dilatedIndex][column];
+	const auto height = cameraImage.silhouette.height();
+
+	const auto bottomRow = double(span.bottomRow);
+	const auto rowStep = double(span.rowStep);
+	const auto estimateRow = [bottomRow, rowStep](int z)
+	{
+		return int(std::round(bottomRow + rowStep * double(z)));
+	};
+
+	for (const auto& interval : intervals)
+	{
+		int z = interval.first;
+		while (z < interval.second)
+		{
+			const auto visible = isVisibleFromCamera(cameraImage, m_voxelGrid.voxel(x, y, z));
+
+			// By default, only this voxel is classified
+			auto next = z + 1;
+
+			int firstRow;
+			int lastRow;
+			if (findColumnRun(runs, height, estimateRow(z), firstRow, lastRow) == visible)
+			{
+				const auto isInRun = [&estimateRow, firstRow, lastRow](int voxel)
+				{
+					const auto row = estimateRow(voxel);
+					return row >= firstRow && row <= lastRow;
+				};
+
+				// Estimate the first voxel whose row leaves the run
+				next = interval.second;
+				if (rowStep != 0.0)
+				{
+					const auto boundary = rowStep > 0.0 ? double(lastRow) + 0.5 : double(firstRow) - 0.5;
+					const auto crossing = std::ceil((boundary - bottomRow) / rowStep);
+
+					next = int(clamp(crossing, double(z + 1), double(interval.second)));
+				}
+
+				// Correct the estimation around the rounding of rows
+				while (next > z + 1 && !isInRun(next - 1))
+				{
+					next--;
+				}
+
+				while (next < interval.second && isInRun(next))
+				{
+					next++;
+				}
+
+				// Voxels inside the run have the same visibility, the last one is checked for rounding ties
+				while (next > z + 1 && isVisibleFromCamera(cameraImage, m_voxelGrid.voxel(x, y, next - 1)) != visible)
+				{
+					next--;
+				}
+			}
+
+			if (visible)
+			{
+				addInterval(visibleIntervals, z, next);
+			}
+
+			z = next;
+		}
+	}
+}
+
+void VoxelCarver::loadColumnSpans(ProjectionCache& projectionCache) const
+{
+	const auto numberSpans = m_cameras.size() * std::size_t(m_voxelGrid.resolutionX()) * std::size_t(m_voxelGrid.resolutionY());
+
+	// Everything that changes the projection of columns is part of the key
+	const auto& boundingBox = m_voxelGrid.boundingBox();
+	std::vector<float> keyValues = {
+		boundingBox.minX(), boundingBox.minY(), boundingBox.minZ(),
+		boundingBox.maxX(), boundingBox.maxY(), boundingBox.maxZ(),
+		float(m_voxelGrid.resolutionX()), float(m_voxelGrid.resolutionY()), float(m_voxelGrid.resolutionZ()),
+		m_maximumRadiusAroundVoxel
+	};
+
+	for (const auto& cameraImage : m_cameras)
+	{
+		const auto& camera = cameraImage.camera;
+		keyValues.insert(keyValues.end(), {
+			camera.eye().x(), camera.eye().y(), camera.eye().z(),
+			camera.at().x(), camera.at().y(), camera.at().z(),
+			camera.up().x(), camera.up().y(), camera.up().z(),
+			camera.fovy(), camera.aspectRatio(), camera.nearPlane(), camera.farPlane(),
+			float(cameraImage.silhouette.width()), float(cameraImage.silhouette.height()),
+			float(cameraImage.offsetX), float(cameraImage.offsetY),
+			cameraImage.verticalColumns ? 1.0f : 0.0f
+		});
+	}
+
+	const auto key = ProjectionCache::computeKey(keyValues);
+	const auto fileName = m_projectionCacheDirectory.isEmpty()
+	                    ? QString()
+	                    : QDir(m_projectionCacheDirectory).filePath("projections_" + QString::number(key, 16) + ".bin");
+
+	if (!fileName.isEmpty() && projectionCache.load(fileName, key, numberSpans))
+	{
+		return;
+	}
+
+	std::vector<ProjectionCache::ColumnSpan> spans(numberSpans);
+
+	#pragma omp parallel for
+	for (int x = 0; x < m_voxelGrid.resolutionX(); x++)
+	{
+		for (int c = 0; c < int(m_cameras.size()); c++)
+		{
+			// Spans of other cameras are not used
+			if (!m_cameras[c].verticalColumns)
+			{
+				continue;
+			}
+
+			for (int y = 0; y < m_voxelGrid.resolutionY(); y++)
+			{
+				spans[columnSpanIndex(c, x, y)] = computeColumnSpan(m_cameras[c], x, y);
+			}
+		}
+	}
+
+	projectionCache.setSpans(std::move(spans));
+
+	if (!fileName.isEmpty() && !projectionCache.save(fileName, key))
+	{
+		qWarning() << "Cannot write the projection cache" << fileName;
+	}
+}
+
+std::size_t VoxelCarver::columnSpanIndex(int camera, int x, int y) const
+{
+	return (std::size_t(camera) * m_voxelGrid.resolutionX() + x) * m_voxelGrid.resolutionY() + y;
+}
+
+void VoxelCarver::carveColumnIntervals(
+	const CameraImage& cameraImage,
+	int x, int y,
+	const ZIntervals& intervals,
+	ZIntervals& visibleIntervals) const
+{
+	// Below this length, voxels are directly tested against the camera
+	const int leafLength = 4;
+
+	// Intervals are split in halves until they can be classified, as cells of an octree
+	ZIntervals pendingIntervals;
+
+	for (const auto& interval : intervals)
+	{
+		pendingIntervals.push_back(interval);
+
+		while (!pendingIntervals.empty())
+		{
+			// The last interval is the lowest one, intervals are added in increasing Z order
+			const auto current = pendingIntervals.back();
+			pendingIntervals.pop_back();
+
+			const VoxelCell cell(x, y, current.first, x + 1, y + 1, current.second);
+			const auto visibility = classifyCell(cameraImage, cameraImage.pyramids, cell);
+
+			if (visibility == CellVisibility::Inside)
+			{
+				addInterval(visibleIntervals, current.first, current.second);
+			}
+			else if (visibility == CellVisibility::Partial)
+			{
+				if (current.second - current.first <= leafLength)
+				{
+					carveColumnVoxels(cameraImage, x, y, ZIntervals(1, current), visibleIntervals);
+				}
+				else
+				{
+					const auto middle = current.first + (current.second - current.first + 1) / 2;
+
+					pendingIntervals.emplace_back(middle, current.second);
+					pendingIntervals.emplace_back(current.first, middle);
+				}
+			}
+		}
+	}
+}
+
+void VoxelCarver::carveColumnVoxels(
+	const CameraImage& cameraImage,
+	int x, int y,
+	const ZIntervals& intervals,
+	ZIntervals& visibleIntervals) const
+{
+	for (const auto& interval : intervals)
+	{
+		for (int z = interval.first; z < interval.second; z++)
+		{
+			if (isVisibleFromCamera(cameraImage, m_voxelGrid.voxel(x, y, z)))
+			{
+				addInterval(visibleIntervals, z, z + 1);
+			}
+		}
+	}
+}
+
+void VoxelCarver::addInterval(ZIntervals& intervals, int start, int end)
+{
+	if (!intervals.empty() && intervals.back().second == start)
+	{
+		intervals.back().second = end;
+	}
+	else
+	{
+		intervals.emplace_back(start, end);
+	}
+}
+
+bool VoxelCarver::findColumnRun(
+	const std::vector<std::pair<int, int>>& runs,
+	int height,
+	int row,
+	int& firstRow,
+	int& lastRow)
+{
+	// Runs touching the border of the image continue with pixels out of the image
+	const auto extendRun = [height, &firstRow, &lastRow]()
+	{
+		if (firstRow <= 0)
+		{
+			firstRow = std::numeric_limits<int>::min();
+		}
+
+		if (lastRow >= height - 1)
+		{
+			lastRow = std::numeric_limits<int>::max();
+		}
+	};
+
+	// Pixels out of the image are considered present
+	if (row < 0 || row >= height)
+	{
+		if (row < 0)
+		{
+			firstRow = -1;
+			lastRow = (!runs.empty() && runs.front().first == 0) ? runs.front().second : -1;
+		}
+		else
+		{
+			firstRow = (!runs.empty() && runs.back().second == height - 1) ? runs.back().first : height;
+			lastRow = height;
+		}
+
+		extendRun();
+		return true;
+	}
+
+	// First run starting after the row
+	const auto next = std::upper_bound(runs.begin(), runs.end(), row,
+		[](int r, const std::pair<int, int>& run)
+		{
+			return r < run.first;
+		});
+
+	if (next != runs.begin() && std::prev(next)->second >= row)
+	{
+		firstRow = std::prev(next)->first;
+		lastRow = std::prev(next)->second;
+
+		extendRun();
+		return true;
+	}
+
+	// The row is in a gap between two runs
+	firstRow = (next != runs.begin()) ? std::prev(next)->second + 1 : 0;
+	lastRow = (next != runs.end()) ? next->first - 1 : height - 1;
+
+	return false;
+}
+
+VoxelCarver::CellVisibility VoxelCarver::classifyCell(
+	const CameraImage& cameraImage,
+	const SilhouettePyramids& silhouettePyramids,
+	const VoxelCell& cell) const
+{
+	// Dimensions of the image
+	const auto cols = cameraImage.silhouette.width();
+	const auto rows = cameraImage.silhouette.height();
+
+	const auto viewDirection = cameraImage.camera.at() - cameraImage.camera.eye();
+
+	// Bounding rectangle of the projection of the cell
+	float minPixelX = std::numeric_limits<float>::max();
+	float minPixelY = std::numeric_limits<float>::max();
+	float maxPixelX = std::numeric_limits<float>::lowest();
+	float maxPixelY = std::numeric_limits<float>::lowest();
+
+	// The projection of a box is the convex hull of the projection of its corners
+	for (const auto x : { cell.startX, cell.endX - 1 })
+	{
+		for (const auto y : { cell.startY, cell.endY - 1 })
+		{
+			for (const auto z : { cell.startZ, cell.endZ - 1 })
+			{
+				const auto point = m_voxelGrid.voxel(x, y, z);
+
+				const auto realPixel = cameraImage.projection.project(point);
+
+				// If the corner is behind the camera or out of its frustum, the cell cannot be classified
+				if (QVector3D::dotProduct(point - cameraImage.camera.eye(), viewDirection) <= 0.0f
+				 || realPixel.x() < 0.0f)
+				{
+					return CellVisibility::Partial;
+				}
+
+				minPixelX = std::min(minPixelX, realPixel.x());
+				minPixelY = std::min(minPixelY, realPixel.y());
+				maxPixelX = std::max(maxPixelX, realPixel.x());
+				maxPixelY = std::max(maxPixelY, realPixel.y());
+			}
+		}
+	}
+
+	// Pixels looked up by voxels of the cell, with a margin of one pixel for rounding errors
+	const auto startX = int(std::round(minPixelX + float(cameraImage.offsetX))) - 1;
+	const auto startY = int(std::round(minPixelY + float(cameraImage.offsetY))) - 1;
+	const auto endX = int(std::round(maxPixelX + float(cameraImage.offsetX))) + 1;
+	const auto endY = int(std::round(maxPixelY + float(cameraImage.offsetY))) + 1;
+
+	// Pixels out of the image are always considered present
+	const auto clippedStartX = std::max(startX, 0);
+	const auto clippedStartY = std::max(startY, 0);
+	const auto clippedEndX = std::min(endX, cols - 1);
+	const auto clippedEndY = std::min(endY, rows - 1);
+
+	// The projection of the cell is completely out of the image: every voxel of the cell is visible
+	if (clippedStartX > clippedEndX || clippedStartY > clippedEndY)
+	{
+		return CellVisibility::Inside;
+	}
+
+	// The projection of the cell is in the image
+	if (clippedStartX == startX && clippedStartY == startY && clippedEndX == endX && clippedEndY == endY)
+	{
+		// Not a single neighborhood contains a pixel of the object: no voxel of the cell is visible
+		if (silhouettePyramids.maximumOffset.isEmpty(startX, startY, endX, endY))
+		{
+			return CellVisibility::Outside;
+		}
+	}
+
+	// Every neighborhood contains a pixel of the object: every voxel of the cell is visible
+	if (silhouettePyramids.minimumOffset.isFull(clippedStartX, clippedStartY, clippedEndX, clippedEndY))
+	{
+		return CellVisibility::Inside;
+	}
+
+	return CellVisibility::Partial;
+}
+
+SilhouetteMask VoxelCarver::computeSilhouette(const cv::Mat& image) const
+{
+	SilhouetteMask silhouette(image.cols, image.rows);
+
+	for (int i = 0; i < image.rows; i++)
+	{
+		for (int j = 0; j < image.cols; j++)
+		{
+			if (isPixelInObject(image, i, j))
+			{
+				silhouette.set(j, i);
+			}
+		}
+	}
+
+	return silhouette;
+}
+
+void VoxelCarver::updateDilatedSilhouettes(CameraImage& cameraImage) const
+{
+	cameraImage.diagonal = m_maximumRadiusAroundVoxel * (cameraImage.camera.up() + cameraImage.camera.right()) * M_SQRT1_2;
+
+	// Range of sizes of the neighborhood in the voxel grid
+	int minimumOffset = std::numeric_limits<int>::max();
+	int maximumOffset = 0;
+
+	const auto& boundingBox = m_voxelGrid.boundingBox();
+	const auto eye = cameraImage.camera.eye();
+
+	// The neighborhood is the largest at the point of the grid that is the closest to the camera
+	std::vector<QVector3D> points = {
+		QVector3D(clamp(eye.x(), boundingBox.minX(), boundingBox.maxX()),
+		          clamp(eye.y(), boundingBox.minY(), boundingBox.maxY()),
+		          clamp(eye.z(), boundingBox.minZ(), boundingBox.maxZ()))
+	};
+
+	for (const auto x : { 0, m_voxelGrid.resolutionX() - 1 })
+	{
+		for (const auto y : { 0, m_voxelGrid.resolutionY() - 1 })
+		{
+			for (const auto z : { 0, m_voxelGrid.resolutionZ() - 1 })
+			{
+				points.push_back(m_voxelGrid.voxel(x, y, z));
+			}
+		}
+	}
+
+	for (const auto& point : points)
+	{
+		const auto realPixel = cameraImage.projection.project(point);
+		const auto realDiagonalPixel = cameraImage.projection.project(point + cameraImage.diagonal);
+
+		// Points out of the camera frustum are always visible, whatever the neighborhood
+		if (realPixel.x() >= 0.0f && realDiagonalPixel.x() >= 0.0f)
+		{
+			const auto offset = int(std::ceil(realPixel.distanceToPoint(realDiagonalPixel)));
+
+			minimumOffset = std::min(minimumOffset, offset);
+			maximumOffset = std::max(maximumOffset, offset);
+		}
+	}
+
+	// The size of the neighborhood is only sampled, keep a margin of one pixel
+	// Voxels out of this range fall back to looking at the whole neighborhood
+	if (minimumOffset > maximumOffset)
+	{
+		// No point is in the frustum of the camera
+		minimumOffset = 0;
+		maximumOffset = 0;
+	}
+	else
+	{
+		minimumOffset = std::max(minimumOffset - 1, 0);
+		maximumOffset = maximumOffset + 1;
+	}
+
+	cameraImage.minimumOffset = minimumOffset;
+	cameraImage.dilatedSilhouettes.clear();
+
+	for (int offset = minimumOffset; offset <= maximumOffset; offset++)
+	{
+		cameraImage.dilatedSilhouettes.push_back(cameraImage.silhouette.dilated(offset));
+	}
+
+	// Horizontal cameras whose up vector is vertical see vertical columns of voxels as columns of pixels
+	const auto viewDirection = (cameraImage.camera.at() - cameraImage.camera.eye()).normalized();
+	const auto up = cameraImage.camera.up().normalized();
+	cameraImage.verticalColumns = std::abs(viewDirection.z()) < 1e-3f && std::abs(up.z()) > 1.0f - 1e-3f;
+
+	cameraImage.dilatedColumnRuns.clear();
+
+	if (cameraImage.verticalColumns)
+	{
+		for (const auto& dilatedSilhouette : cameraImage.dilatedSilhouettes)
+		{
+			cameraImage.dilatedColumnRuns.push_back(dilatedSilhouette.columnRuns());
+		}
+	}
+
+	// Pyramids classify octree cells in a few words whatever their size
+	cameraImage.pyramids.minimumOffset = OccupancyPyramid(cameraImage.dilatedSilhouettes.front());
+	cameraImage.pyramids.maximumOffset = OccupancyPyramid(cameraImage.dilatedSilhouettes.back());
+}
+
+const std::vector<float>& VoxelCarver::cameraRejectionRates() const
+{
+	return m_cameraRejectionRates;
+}
+
+const std::vector<int>& VoxelCarver::cameraOrder() const
+{
+	return m_cameraOrder;
 }
 
 bool VoxelCarver::isVoxelGridReady() const
@@ -179,9 +2168,9 @@ float VoxelCarver::reprojectionError(const VoxelGrid& grid, std::vector<cv::Mat>
 	reprojections.clear();
 	for (const auto& camera : m_cameras)
 	{
-		reprojections.emplace_back(camera.image.rows,
-		                           camera.image.cols,
-		                           camera.image.type(),
+		reprojections.emplace_back(camera.silhouette.height(),
+		                           camera.silhouette.width(),
+		                           CV_8UC3,
 		                           tnColor);
 	}
 
@@ -192,10 +2181,10 @@ float VoxelCarver::reprojectionError(const VoxelGrid& grid, std::vector<cv::Mat>
 	#pragma omp parallel for shared(truePositives, falsePositives, falseNegatives)
 	for (int c = 0; c < m_cameras.size(); c++)
 	{
-		const auto cameraImage = m_cameras[c];
+		const auto& cameraImage = m_cameras[c];
 		
-		const auto width = cameraImage.image.cols;
-		const auto height = cameraImage.image.rows;
+		const auto width = cameraImage.silhouette.width();
+		const auto height = cameraImage.silhouette.height();
 		
 		// Re project voxel cubes on this camera
 		const auto projectedGridImage = cameraImage.camera.render(QMatrix4x4(),
@@ -213,7 +2202,7 @@ float VoxelCarver::reprojectionError(const VoxelGrid& grid, std::vector<cv::Mat>
 			for (int j = 0; j < width; j++)
 			{
 				// Reference
-				const auto mask = isPixelInObject(cameraImage.image, i, j);
+				const auto mask = cameraImage.silhouette.get(j, i);
 				// Prediction
 				const auto projection = isPixelInObject(projectedGrid, i, j);
 
@@ -265,9 +2254,9 @@ bool VoxelCarver::isPixelInObject(const cv::Mat& image, int i, int j) const
 	// Read the color of the pixel in the image
 	const auto pixel = image.at<cv::Vec3b>(i, j);
 
-	// The image is in BGR format
-	const QColor color(pixel.val[2], pixel.val[1], pixel.val[0]);
+	// The value in the HSV color model is the maximum of the three channels
+	const int value = std::max({ pixel.val[0], pixel.val[1], pixel.val[2] });
 
 	// If the corresponding pixel in the image is not white, the point is part the object
-	return color.value() < m_colorThreshold;
+	return value < m_colorThreshold;
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <utility>
 
 #include <QImage>
@@ -8,12 +10,30 @@
 
 #include "AABB.h"
 #include "Camera.h"
+#include "CameraProjection.h"
+#include "ProjectionCache.h"
+#include "SilhouetteMask.h"
 #include "VoxelGrid.h"
 
+/**
+ * \brief Strategy used by the voxel carver to traverse the voxel grid
+ */
+enum class CarvingMode
+{
+	Exhaustive,     // Test every voxel of the grid against every camera
+	Hierarchical,   // Test octree cells against cameras and only subdivide cells straddling a silhouette
+	ColumnInterval, // Intersect intervals of voxels along Z columns with the silhouette runs seen by cameras
+	Incremental     // Only test added cameras on remaining voxels, and restore voxels of removed cameras from visibility counts
+};
+
 class VoxelCarver
 {
 public:
-	VoxelCarver(const AABB& boundingBox, int resolutionX, int resolutionY, int resolutionZ);
+	VoxelCarver(const AABB& boundingBox,
+	            int resolutionX,
+	            int resolutionY,
+	            int resolutionZ,
+	            VoxelStorage storage = VoxelStorage::Dense);
 
 	/**
 	 * \brief The maximum radius around a voxel in which we look for a corresponding pixel
@@ -21,6 +41,21 @@ public:
 	 */
 	void setMaximumRadiusAroundVoxel(float maximumRadiusAroundVoxel);
 
+	/**
+	 * \brief Select how the voxel grid is traversed when carving
+	 *        All modes produce the same voxel grid
+	 * \param carvingMode The new carving mode
+	 */
+	void setCarvingMode(CarvingMode carvingMode);
+
+	/**
+	 * \brief Set the directory in which projections of the voxel grid on cameras are cached
+	 *        The cache is used by the ColumnInterval carving mode and shared by all plants
+	 *        imaged with the same cameras, bounding box and resolution
+	 * \param directory The directory of the cache, no cache is used if empty
+	 */
+	void setProjectionCacheDirectory(const QString& directory);
+
 	/**
 	 * \brief Add a camera and its associated picture for reconstruction
 	 * \param camera The settings of the camera
@@ -30,6 +65,13 @@ public:
 	 */
 	void addCameraImage(const Camera& camera, const cv::Mat& image, int offsetX = 0, int offsetY = 0);
 
+	/**
+	 * \brief Remove a camera and its associated picture
+	 *        In incremental mode, voxels only rejected by this camera are restored by the next process()
+	 * \param index The index of the camera in insertion order
+	 */
+	void removeCamera(int index);
+
 	/**
 	 * \brief Delete all cameras in the voxel carver
 	 */
@@ -48,6 +90,29 @@ public:
 	 */
 	void process();
 
+	/**
+	 * \brief Carve the voxel grids of several plants imaged by the same cameras in a single sweep
+	 *        Projections of voxels are computed once and plants are tested together, one bit per plant
+	 *        Cameras are the ones added with addCameraImage, their own pictures are not used
+	 * \param images For each plant, its pictures taken by each camera in insertion order (at most 64 plants)
+	 * \return For each plant, its carved voxel grid
+	 */
+	std::vector<VoxelGrid> processBatch(const std::vector<std::vector<cv::Mat>>& images) const;
+
+	/**
+	 * \brief Return the fraction of voxels rejected by each camera
+	 *        Rates are estimated on a sample of the voxel grid at the beginning of process()
+	 * \return For each camera in insertion order, the fraction of sampled voxels not visible from it
+	 */
+	const std::vector<float>& cameraRejectionRates() const;
+
+	/**
+	 * \brief Return the order in which cameras are tested
+	 *        The most selective cameras are tested first to reject voxels as early as possible
+	 * \return Indices of cameras in test order
+	 */
+	const std::vector<int>& cameraOrder() const;
+
 	/**
 	 * \brief Return True if the voxel grid is ready to be used
 	 * \return True after space has been successfully carved, false otherwise
@@ -77,34 +142,555 @@ public:
 	
 private:
 	/**
-	 * \brief A struct holding a camera and the picture associated to it
+	 * \brief Occupancy pyramids of the dilated silhouettes of a camera, to classify octree cells
+	 */
+	struct SilhouettePyramids
+	{
+		/**
+		 * \brief Pyramid of the silhouette dilated by the smallest neighborhood
+		 */
+		OccupancyPyramid minimumOffset;
+
+		/**
+		 * \brief Pyramid of the silhouette dilated by the largest neighborhood
+		 */
+		OccupancyPyramid maximumOffset;
+	};
+
+	/**
+	 * \brief A struct holding a camera and the silhouette of the object in its picture
 	 */
 	struct CameraImage
 	{
 		Camera camera;
-		cv::Mat image;
 		int offsetX;
 		int offsetY;
 
-		CameraImage(const Camera& camera, cv::Mat image) :
+		/**
+		 * \brief Pixels of the picture that are in the object
+		 */
+		SilhouetteMask silhouette;
+
+		/**
+		 * \brief Projection of the camera on the picture
+		 */
+		CameraProjection projection;
+
+		/**
+		 * \brief Displacement from a voxel to the corner of its neighborhood in the image plane
+		 */
+		QVector3D diagonal;
+
+		/**
+		 * \brief Size of the smallest neighborhood around the projection of a voxel
+		 */
+		int minimumOffset;
+
+		/**
+		 * \brief The silhouette dilated by each possible size of neighborhood, starting from minimumOffset
+		 *        A pixel is set if its neighborhood contains a pixel of the object or goes out of the image
+		 */
+		std::vector<SilhouetteMask> dilatedSilhouettes;
+
+		/**
+		 * \brief True if vertical columns of voxels project on columns of pixels, as for horizontal cameras
+		 */
+		bool verticalColumns;
+
+		/**
+		 * \brief Runs of pixels in the columns of each dilated silhouette, only if verticalColumns is true
+		 */
+		std::vector<SilhouetteMask::ColumnRuns> dilatedColumnRuns;
+
+		/**
+		 * \brief Pyramids of the smallest and largest dilated silhouettes, built with them
+		 */
+		SilhouettePyramids pyramids;
+
+		CameraImage(const Camera& camera, SilhouetteMask silhouette, int offsetX, int offsetY) :
 			camera(camera),
-			image(std::move(image)),
-			offsetX(0),
-			offsetY(0)
+			offsetX(offsetX),
+			offsetY(offsetY),
+			silhouette(std::move(silhouette)),
+			projection(camera, float(this->silhouette.width()), float(this->silhouette.height())),
+			minimumOffset(0),
+			verticalColumns(false)
 		{
-			
+
 		}
+	};
 
-		CameraImage(const Camera& camera, cv::Mat image, int offsetX, int offsetY) :
-			camera(camera),
-			image(std::move(image)),
-			offsetX(offsetX),
-			offsetY(offsetY)
+	/**
+	 * \brief Visibility of an octree cell with regard to one camera
+	 */
+	enum class CellVisibility
+	{
+		Outside, // No voxel of the cell can be seen in the object
+		Inside,  // Every voxel of the cell is seen in the object
+		Partial  // The cell straddles the silhouette and needs to be subdivided
+	};
+
+	/**
+	 * \brief A box of voxels in the grid, coordinates are in [start; end[
+	 */
+	struct VoxelCell
+	{
+		int startX;
+		int startY;
+		int startZ;
+		int endX;
+		int endY;
+		int endZ;
+
+		VoxelCell(int startX, int startY, int startZ, int endX, int endY, int endZ) :
+			startX(startX),
+			startY(startY),
+			startZ(startZ),
+			endX(endX),
+			endY(endY),
+			endZ(endZ)
+		{
+
+		}
+
+		int sizeX() const { return endX - startX; }
+		int sizeY() const { return endY - startY; }
+		int sizeZ() const { return endZ - startZ; }
+	};
+
+	/**
+	 * \brief Buffers used to project a column of voxels, reused between columns to avoid allocations
+	 */
+	struct ColumnBuffers
+	{
+		std::vector<float> pointsX;
+		std::vector<float> pointsY;
+		std::vector<float> pointsZ;
+		std::vector<float> diagonalsX;
+		std::vector<float> diagonalsY;
+		std::vector<float> diagonalsZ;
+		std::vector<float> pixelsX;
+		std::vector<float> pixelsY;
+		std::vector<float> diagonalPixelsX;
+		std::vector<float> diagonalPixelsY;
+		std::vector<unsigned char> inside;
+		std::vector<std::uint64_t> lanes;
+	};
+
+	/**
+	 * \brief Silhouettes of several plants seen by one camera, bit p of a pixel is set for plant p
+	 *        Each pixel stores the bits of all plants in the smallest word that holds them, of 1, 2, 4 or 8 bytes
+	 */
+	struct BatchSilhouettes
+	{
+		/**
+		 * \brief Number of bytes of the word of a pixel
+		 */
+		int laneBytes;
+
+		/**
+		 * \brief Pixels of the pictures that are in the plants, one word per pixel in row-major order
+		 */
+		std::vector<unsigned char> lanes;
+
+		/**
+		 * \brief The lanes dilated by each possible size of neighborhood of the camera, starting from minimumOffset
+		 */
+		std::vector<std::vector<unsigned char>> dilatedLanes;
+
+		BatchSilhouettes() :
+			laneBytes(8)
+		{
+
+		}
+
+		/**
+		 * \brief Return the bits of the plants in the word of a pixel
+		 * \param words The lanes or dilated lanes
+		 * \param index The index of the pixel
+		 * \return Bit p is set if the pixel is in plant p
+		 */
+		std::uint64_t load(const std::vector<unsigned char>& words, std::size_t index) const
 		{
+			const auto* word = &words[index * laneBytes];
+
+			switch (laneBytes)
+			{
+			case 1:
+				return *word;
+			case 2:
+			{
+				std::uint16_t value;
+				std::memcpy(&value, word, sizeof(value));
+				return value;
+			}
+			case 4:
+			{
+				std::uint32_t value;
+				std::memcpy(&value, word, sizeof(value));
+				return value;
+			}
+			default:
+			{
+				std::uint64_t value;
+				std::memcpy(&value, word, sizeof(value));
+				return value;
+			}
+			}
+		}
 
+		/**
+		 * \brief Write the bits of the plants in the word of a pixel, bits after the last plant are dropped
+		 * \param words The lanes or dilated lanes
+		 * \param index The index of the pixel
+		 * \param value Bit p is set if the pixel is in plant p
+		 */
+		void store(std::vector<unsigned char>& words, std::size_t index, std::uint64_t value) const
+		{
+			// Words are little-endian, the first bytes of the value hold the first plants
+			std::memcpy(&words[index * laneBytes], &value, laneBytes);
 		}
 	};
 
+	/**
+	 * \brief Check whether a query point is seen in the object by one camera
+	 * \param cameraImage The camera and its associated picture
+	 * \param point The query point
+	 * \return True if at least one pixel around the projection of the point is in the object
+	 */
+	bool isVisibleFromCamera(const CameraImage& cameraImage, const QVector3D& point) const;
+
+	/**
+	 * \brief Check whether a projected point is seen in the object by one camera
+	 * \param cameraImage The camera and its associated picture
+	 * \param realPixel The projection of the point
+	 * \param realDiagonalPixel The projection of the point displaced by the diagonal of the camera
+	 * \return True if at least one pixel around the projection of the point is in the object
+	 */
+	bool isVisibleFromCamera(const CameraImage& cameraImage, const QVector2D& realPixel, const QVector2D& realDiagonalPixel) const;
+
+	/**
+	 * \brief Check from which plants a projected point is seen by one camera
+	 * \param cameraImage The camera
+	 * \param batchSilhouettes The silhouettes of the plants seen by the camera
+	 * \param realPixel The projection of the point
+	 * \param realDiagonalPixel The projection of the point displaced by the diagonal of the camera
+	 * \return Bit p is set if at least one pixel around the projection of the point is in plant p
+	 */
+	std::uint64_t visibleLanesFromCamera(const CameraImage& cameraImage,
+	                                     const BatchSilhouettes& batchSilhouettes,
+	                                     const QVector2D& realPixel,
+	                                     const QVector2D& realDiagonalPixel) const;
+
+	/**
+	 * \brief Carve a column of voxels along the Z axis
+	 *        Voxels of the column are projected together on each camera
+	 * \param x The X coordinate of the column
+	 * \param y The Y coordinate of the column
+	 * \param startZ The first voxel of the column
+	 * \param endZ The voxel after the last voxel of the column
+	 * \param cameras Indices of cameras against which voxels are tested
+	 * \param buffers Buffers for the projection of the column
+	 * \param voxels Output the list of voxels inside the object
+	 */
+	void carveColumn(int x, int y, int startZ, int endZ,
+	                 const std::vector<int>& cameras,
+	                 ColumnBuffers& buffers,
+	                 std::vector<Voxel>& voxels) const;
+
+	/**
+	 * \brief Estimate the rejection rate of each camera on a sample of the voxel grid
+	 *        and order cameras so that sampled voxels are rejected after as few tests as possible
+	 */
+	void updateCameraOrder();
+
+	/**
+	 * \brief Compute the box of voxels that may be visible from all cameras
+	 *        The bounding rectangle of each silhouette is back-projected into a frustum, and frusta are intersected
+	 *        Cameras for which the grid is not entirely in the image are not taken into account,
+	 *        since pixels out of the image are considered in the object
+	 * \return The box of voxels to carve, empty if no voxel can be visible
+	 */
+	VoxelCell computeCarvingDomain() const;
+
+	/**
+	 * \brief Carve the voxel grid by tiles of columns along the Z axis, processed independently by threads
+	 *        The voxels of each tile are directly written at their place in the sorted output
+	 * \param domain The box of voxels to carve, voxels out of the box are not in the object
+	 * \param carveTile Function carving a tile with the buffers of the thread, it must output
+	 *        the voxels of each column by increasing Z: void(const VoxelCell&, ThreadBuffers&, std::vector<Voxel>&)
+	 * \param voxels Output the sorted list of voxels inside the object
+	 */
+	template<typename ThreadBuffers, typename CarveTile>
+	void carveTiles(const VoxelCell& domain, CarveTile carveTile, std::vector<Voxel>& voxels) const;
+
+	/**
+	 * \brief Split the voxel grid in cells
+	 * \param cellSize The size of cells, cells on the border of the grid may be smaller
+	 * \return The cells covering the voxel grid
+	 */
+	std::vector<VoxelCell> splitInCells(int cellSize) const;
+
+	/**
+	 * \brief Split a cell in at most 8 children, cells flat along an axis have fewer children
+	 * \param cell The cell to subdivide
+	 * \return The children in X, then Y, then Z order
+	 */
+	static std::vector<VoxelCell> subdivideCell(const VoxelCell& cell);
+
+	/**
+	 * \brief Carve the voxel grid by testing each voxel against each camera
+	 * \param domain The box of voxels to carve
+	 * \param voxels Output the sorted list of voxels inside the object
+	 */
+	void processExhaustive(const VoxelCell& domain, std::vector<Voxel>& voxels) const;
+
+	/**
+	 * \brief Carve the voxel grid coarse-to-fine with an octree
+	 * \param domain The box of voxels to carve
+	 * \param voxels Output the sorted list of voxels inside the object
+	 */
+	void processHierarchical(const VoxelCell& domain, std::vector<Voxel>& voxels) const;
+
+	/**
+	 * \brief Recursively carve an octree cell
+	 * \param cell The cell to carve
+	 * \param activeCameras Indices of cameras for which the cell is not known to be inside the silhouette
+	 * \param buffers Buffers for the projection of columns of voxels
+	 * \param voxels Output the list of voxels inside the object
+	 */
+	void carveCell(const VoxelCell& cell,
+	               const std::vector<int>& activeCameras,
+	               ColumnBuffers& buffers,
+	               std::vector<Voxel>& voxels) const;
+
+	/**
+	 * \brief Compute the silhouettes of several plants seen by one camera
+	 * \param camera The index of the camera
+	 * \param images For each plant, its pictures taken by each camera
+	 * \param silhouettePyramids Output the occupancy pyramids of the union of the plants
+	 *        for the largest neighborhood and of their intersection for the smallest one
+	 * \return The silhouettes of the plants
+	 */
+	BatchSilhouettes computeBatchSilhouettes(int camera,
+	                                         const std::vector<std::vector<cv::Mat>>& images,
+	                                         SilhouettePyramids& silhouettePyramids) const;
+
+	/**
+	 * \brief Recursively carve an octree cell for several plants at once
+	 *        A cell is skipped if it is outside the silhouettes of all plants for one camera
+	 * \param cell The cell to carve
+	 * \param activeCameras Indices of cameras for which the cell is not known to be inside the silhouettes
+	 * \param silhouettePyramids For each camera, the occupancy pyramids of the union and intersection of plants
+	 * \param batchSilhouettes For each camera, the silhouettes of the plants
+	 * \param allLanes The bits of the plants in the batch
+	 * \param buffers Buffers for the projection of columns of voxels
+	 * \param voxels Output the voxels inside at least one plant, with the bits of these plants
+	 */
+	void carveBatchCell(const VoxelCell& cell,
+	                    const std::vector<int>& activeCameras,
+	                    const std::vector<SilhouettePyramids>& silhouettePyramids,
+	                    const std::vector<BatchSilhouettes>& batchSilhouettes,
+	                    std::uint64_t allLanes,
+	                    ColumnBuffers& buffers,
+	                    std::vector<std::pair<Voxel, std::uint64_t>>& voxels) const;
+
+	/**
+	 * \brief Carve a column of voxels along the Z axis for several plants at once
+	 * \param x The X coordinate of the column
+	 * \param y The Y coordinate of the column
+	 * \param startZ The first voxel of the column
+	 * \param endZ The voxel after the last voxel of the column
+	 * \param cameras Indices of cameras against which voxels are tested
+	 * \param batchSilhouettes For each camera, the silhouettes of the plants
+	 * \param allLanes The bits of the plants in the batch
+	 * \param buffers Buffers for the projection of the column
+	 * \param voxels Output the voxels inside at least one plant, with the bits of these plants
+	 */
+	void carveBatchColumn(int x, int y, int startZ, int endZ,
+	                      const std::vector<int>& cameras,
+	                      const std::vector<BatchSilhouettes>& batchSilhouettes,
+	                      std::uint64_t allLanes,
+	                      ColumnBuffers& buffers,
+	                      std::vector<std::pair<Voxel, std::uint64_t>>& voxels) const;
+
+	/**
+	 * \brief Carve the voxel grid with the cameras added or removed since the last pass
+	 *        Voxels of the previous pass are tested against added cameras, and voxels
+	 *        rejected by removed cameras are restored from the visibility counts
+	 * \param domain The box of voxels to carve when the grid is carved from scratch
+	 * \param voxels Output the sorted list of voxels inside the object
+	 */
+	void processIncremental(const VoxelCell& domain, std::vector<Voxel>& voxels);
+
+	/**
+	 * \brief Add or remove a camera in the visibility counts of voxels
+	 * \param camera The index of the camera
+	 * \param increment 1 to add the camera, -1 to remove it
+	 */
+	void updateVisibilityCounts(int camera, int increment);
+
+	/**
+	 * \brief Recursively add or remove a camera in the visibility counts of the voxels of a cell
+	 * \param cell The cell to count
+	 * \param camera The index of the camera
+	 * \param increment 1 to add the camera, -1 to remove it
+	 * \param buffers Buffers for the projection of columns of voxels
+	 * \param visibleVoxels Buffer for the voxels of leaf cells visible from the camera
+	 */
+	void countCell(const VoxelCell& cell,
+	               int camera,
+	               int increment,
+	               ColumnBuffers& buffers,
+	               std::vector<Voxel>& visibleVoxels);
+
+	/**
+	 * \brief Reset the visibility counts, they are computed again by the next incremental pass
+	 */
+	void resetVisibilityCounts();
+
+	/**
+	 * \brief Intervals [start; end[ of voxels along a Z column, sorted by increasing Z
+	 */
+	using ZIntervals = std::vector<std::pair<int, int>>;
+
+	/**
+	 * \brief Intervals of a column before and after being carved by a camera, reused between columns
+	 */
+	struct IntervalBuffers
+	{
+		ZIntervals intervals;
+		ZIntervals visibleIntervals;
+	};
+
+	/**
+	 * \brief Carve the voxel grid by intersecting Z columns of voxels with the silhouettes
+	 *        Cameras seeing voxel columns as pixel columns are processed with runs of pixels,
+	 *        other cameras are processed with octree cells one voxel wide
+	 * \param domain The box of voxels to carve
+	 * \param voxels Output the sorted list of voxels inside the object
+	 */
+	void processColumnIntervals(const VoxelCell& domain, std::vector<Voxel>& voxels) const;
+
+	/**
+	 * \brief Load the projections of columns on horizontal cameras from the cache, or compute them
+	 * \param projectionCache Output the projections of columns
+	 */
+	void loadColumnSpans(ProjectionCache& projectionCache) const;
+
+	/**
+	 * \brief Return the index of the projection of a column on a camera in the projection cache
+	 * \param camera The index of the camera
+	 * \param x The X coordinate of the column
+	 * \param y The Y coordinate of the column
+	 * \return The index of the span in the projection cache
+	 */
+	std::size_t columnSpanIndex(int camera, int x, int y) const;
+
+	/**
+	 * \brief Project a column of voxels on a camera whose view is horizontal
+	 * \param cameraImage The camera and its associated picture
+	 * \param x The X coordinate of the column
+	 * \param y The Y coordinate of the column
+	 * \return The projection of the column
+	 */
+	ProjectionCache::ColumnSpan computeColumnSpan(const CameraImage& cameraImage, int x, int y) const;
+
+	/**
+	 * \brief Keep the voxels of intervals that are visible from a camera whose view is horizontal
+	 *        The cost is proportional to the number of runs of pixels crossed by the column
+	 * \param cameraImage The camera and its associated picture
+	 * \param span The projection of the column on the camera
+	 * \param x The X coordinate of the column
+	 * \param y The Y coordinate of the column
+	 * \param intervals Intervals of voxels in the column
+	 * \param visibleIntervals Add the intervals of voxels visible from the camera
+	 */
+	void carveVerticalColumn(const CameraImage& cameraImage,
+	                         const ProjectionCache::ColumnSpan& span,
+	                         int x, int y,
+	                         const ZIntervals& intervals,
+	                         ZIntervals& visibleIntervals) const;
+
+	/**
+	 * \brief Keep the voxels of intervals that are visible from a camera
+	 *        Intervals are classified at once when possible, otherwise voxels are tested one by one
+	 * \param cameraImage The camera and its associated picture
+	 * \param x The X coordinate of the column
+	 * \param y The Y coordinate of the column
+	 * \param intervals Intervals of voxels in the column
+	 * \param visibleIntervals Add the intervals of voxels visible from the camera
+	 */
+	void carveColumnIntervals(const CameraImage& cameraImage,
+	                          int x, int y,
+	                          const ZIntervals& intervals,
+	                          ZIntervals& visibleIntervals) const;
+
+	/**
+	 * \brief Keep the voxels of intervals that are visible from a camera, testing voxels one by one
+	 * \param cameraImage The camera and its associated picture
+	 * \param x The X coordinate of the column
+	 * \param y The Y coordinate of the column
+	 * \param intervals Intervals of voxels in the column
+	 * \param visibleIntervals Add the intervals of voxels visible from the camera
+	 */
+	void carveColumnVoxels(const CameraImage& cameraImage,
+	                       int x, int y,
+	                       const ZIntervals& intervals,
+	                       ZIntervals& visibleIntervals) const;
+
+	/**
+	 * \brief Add an interval of voxels to a column, merging it with the last interval if they touch
+	 * \param intervals Intervals of voxels in the column
+	 * \param start The first voxel of the interval
+	 * \param end The voxel after the last voxel of the interval
+	 */
+	static void addInterval(ZIntervals& intervals, int start, int end);
+
+	/**
+	 * \brief Find the run of pixels with the same state as a pixel in a column of a dilated silhouette
+	 *        Pixels out of the image are set, runs touching the border of the image are unbounded
+	 * \param runs Runs of set pixels in the column
+	 * \param height Height of the image
+	 * \param row Row of the pixel
+	 * \param firstRow Output the first row of the run
+	 * \param lastRow Output the last row of the run
+	 * \return True if the pixel is set
+	 */
+	static bool findColumnRun(const std::vector<std::pair<int, int>>& runs,
+	                          int height,
+	                          int row,
+	                          int& firstRow,
+	                          int& lastRow);
+
+	/**
+	 * \brief Conservatively classify a cell with regard to the silhouette seen by a camera
+	 *        A cell is only classified as outside (resp. inside) if isVisibleFromCamera
+	 *        returns false (resp. true) for all voxels in the cell
+	 * \param cameraImage The camera and its associated picture
+	 * \param silhouettePyramids The occupancy pyramids of the dilated silhouettes of this camera
+	 * \param cell The cell to classify
+	 * \return The visibility of the cell from the camera
+	 */
+	CellVisibility classifyCell(const CameraImage& cameraImage,
+	                            const SilhouettePyramids& silhouettePyramids,
+	                            const VoxelCell& cell) const;
+
+	/**
+	 * \brief Threshold a picture to extract the silhouette of the object
+	 * \param image A picture in BGR format
+	 * \return The pixels of the picture that are in the object
+	 */
+	SilhouetteMask computeSilhouette(const cv::Mat& image) const;
+
+	/**
+	 * \brief Update the diagonal of a camera and dilate its silhouette by the projection of the radius around voxels
+	 *        The size of the neighborhood varies slowly across the bounding box,
+	 *        its range is estimated from the corners of the voxel grid and its point closest to the camera
+	 * \param cameraImage The camera for which dilated silhouettes are updated
+	 */
+	void updateDilatedSilhouettes(CameraImage& cameraImage) const;
+
 	/**
 	 * \brief Check that a pixel is in the object when voxel carving
 	 * \param image The image in which to lookup the pixel
@@ -125,6 +711,11 @@ private:
 	 */
 	float m_maximumRadiusAroundVoxel;
 
+	/**
+	 * \brief How the voxel grid is traversed when carving
+	 */
+	CarvingMode m_carvingMode;
+
 	/**
 	 * \brief True after space has been successfully carved
 	 * Means that the voxel grid is ready to use and consistent with cameras
@@ -140,4 +731,41 @@ private:
 	 * \brief A list of camera and their associated pictures
 	 */
 	std::vector<CameraImage> m_cameras;
+
+	/**
+	 * \brief Directory in which projections are cached, empty to disable the cache
+	 */
+	QString m_projectionCacheDirectory;
+
+	/**
+	 * \brief Indices of cameras in the order in which they are tested
+	 */
+	std::vector<int> m_cameraOrder;
+
+	/**
+	 * \brief For each camera, the fraction of sampled voxels not visible from it
+	 */
+	std::vector<float> m_cameraRejectionRates;
+
+	/**
+	 * \brief For each voxel, the number of counted cameras from which it is visible
+	 *        Only used by the incremental mode, empty until a camera is removed
+	 */
+	std::vector<unsigned char> m_visibilityCounts;
+
+	/**
+	 * \brief For each camera, true if it is taken into account in the visibility counts
+	 */
+	std::vector<bool> m_countedCameras;
+
+	/**
+	 * \brief True if the voxel grid holds the voxels seen by its first m_numberCarvedCameras cameras
+	 *        Adding cameras then only removes voxels, no other voxel needs to be tested
+	 */
+	bool m_incrementalVoxelGridValid;
+
+	/**
+	 * \brief Number of cameras, in insertion order, that have carved the voxel grid in incremental mode
+	 */
+	int m_numberCarvedCameras;
 };
@@ -2,27 +2,823 @@
 
 #include <algorithm>
 #include <fstream>
+#include <numeric>
+#include <tuple>
 
 #include <QtMath>
 #include <QImage>
 
 #include <MC33/MC33.h>
 
+#include "DistanceTransform.h"
 #include "MathUtils.h"
 #include "OBJWriter.h"
 #include "Reconstruction.h"
 #include "TriangleBoxIntersection.h"
-#include "UnionFind.h"
 #include "StatsUtils.h"
+#include "VoxelKdTree.h"
+#include "VoxelNeighbors.h"
 
-VoxelGrid::VoxelGrid(const AABB& boundingBox, int resolutionX, int resolutionY, int resolutionZ) :
+namespace
+{
+	/**
+	 * \brief Return a word whose bits from start (included) to end (excluded) are set
+	 */
+	std::uint64_t rangeMask(int start, int end)
+	{
+		assert(start >= 0 && start < end && end <= 64);
+
+		const auto belowEnd = (end == 64) ? ~std::uint64_t(0) : (std::uint64_t(1) << end) - 1;
+		const auto belowStart = (std::uint64_t(1) << start) - 1;
+
+		return belowEnd & ~belowStart;
+	}
+
+	/**
+	 * \brief Words of bits of a box of columns copied from a voxel grid, morphology operations are applied on them
+	 */
+	struct WordBox
+	{
+		int minX;
+		int minY;
+		int sizeX;
+		int sizeY;
+		int wordsPerColumn;
+		std::vector<std::uint64_t> words;
+
+		WordBox(int minX, int minY, int sizeX, int sizeY, int wordsPerColumn) :
+			minX(minX),
+			minY(minY),
+			sizeX(sizeX),
+			sizeY(sizeY),
+			wordsPerColumn(wordsPerColumn),
+			words(std::size_t(sizeX) * std::size_t(sizeY) * std::size_t(wordsPerColumn), 0)
+		{
+
+		}
+
+		/**
+		 * \brief Return the words of a column, coordinates are relative to the box
+		 */
+		std::uint64_t* column(int x, int y)
+		{
+			return words.data() + (std::size_t(x) * sizeY + y) * wordsPerColumn;
+		}
+
+		const std::uint64_t* column(int x, int y) const
+		{
+			return words.data() + (std::size_t(x) * sizeY + y) * wordsPerColumn;
+		}
+
+		/**
+		 * \brief Return a word of a column, columns outside of the box are empty
+		 */
+		std::uint64_t word(int index, int x, int y) const
+		{
+			if (x < 0 || y < 0 || x >= sizeX || y >= sizeY)
+			{
+				return 0;
+			}
+
+			return column(x, y)[index];
+		}
+	};
+
+	/**
+	 * \brief Combine two words, with a OR for a dilation or a AND for an erosion
+	 */
+	std::uint64_t combineWords(std::uint64_t a, std::uint64_t b, bool dilation)
+	{
+		return dilation ? (a | b) : (a & b);
+	}
+
+	/**
+	 * \brief Return a word of a column whose bit for a voxel at z is the bit of the voxel at z + offset
+	 */
+	std::uint64_t shiftedWord(const std::uint64_t* column, int wordsPerColumn, int index, int offset)
+	{
+		assert(offset > -64 && offset < 64);
+
+		if (offset > 0)
+		{
+			const auto next = (index + 1 < wordsPerColumn) ? column[index + 1] : 0;
+
+			return (column[index] >> offset) | (next << (64 - offset));
+		}
+		else if (offset < 0)
+		{
+			const auto previous = (index > 0) ? column[index - 1] : 0;
+
+			return (column[index] << -offset) | (previous >> (64 + offset));
+		}
+
+		return column[index];
+	}
+
+	/**
+	 * \brief Apply a 1D morphology operation along the Z axis, with a segment of 2 * width + 1 voxels
+	 */
+	WordBox morphologyZ(const WordBox& box, int width, bool dilation)
+	{
+		WordBox result(box.minX, box.minY, box.sizeX, box.sizeY, box.wordsPerColumn);
+
+		#pragma omp parallel for
+		for (int x = 0; x < box.sizeX; x++)
+		{
+			for (int y = 0; y < box.sizeY; y++)
+			{
+				const auto column = box.column(x, y);
+				auto resultColumn = result.column(x, y);
+
+				for (int w = 0; w < box.wordsPerColumn; w++)
+				{
+					auto bits = column[w];
+
+					for (int s = 1; s <= width; s++)
+					{
+						bits = combineWords(bits, shiftedWord(column, box.wordsPerColumn, w, s), dilation);
+						bits = combineWords(bits, shiftedWord(column, box.wordsPerColumn, w, -s), dilation);
+					}
+
+					resultColumn[w] = bits;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	/**
+	 * \brief Apply a 1D morphology operation along the X axis (stepX = 1) or the Y axis (stepY = 1),
+	 *        with a segment of 2 * width + 1 voxels
+	 */
+	WordBox morphologyXY(const WordBox& box, int width, int stepX, int stepY, bool dilation)
+	{
+		WordBox result(box.minX, box.minY, box.sizeX, box.sizeY, box.wordsPerColumn);
+
+		#pragma omp parallel for
+		for (int x = 0; x < box.sizeX; x++)
+		{
+			for (int y = 0; y < box.sizeY; y++)
+			{
+				auto resultColumn = result.column(x, y);
+
+				for (int w = 0; w < box.wordsPerColumn; w++)
+				{
+					auto bits = box.word(w, x, y);
+
+					for (int s = 1; s <= width; s++)
+					{
+						bits = combineWords(bits, box.word(w, x + s * stepX, y + s * stepY), dilation);
+						bits = combineWords(bits, box.word(w, x - s * stepX, y - s * stepY), dilation);
+					}
+
+					resultColumn[w] = bits;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	/**
+	 * \brief Apply a morphology operation with a ball of the given radius.
+	 *        The ball is the union of segments along the Z axis, one for each column of the disk of the radius
+	 */
+	WordBox morphologySphere(const WordBox& box, int radius, bool dilation)
+	{
+		// Box after the 1D operation along the Z axis, for each half length of the segments
+		std::vector<WordBox> segments;
+		for (int h = 0; h <= radius; h++)
+		{
+			segments.push_back(morphologyZ(box, h, dilation));
+		}
+
+		WordBox result(box.minX, box.minY, box.sizeX, box.sizeY, box.wordsPerColumn);
+
+		#pragma omp parallel for
+		for (int x = 0; x < box.sizeX; x++)
+		{
+			for (int y = 0; y < box.sizeY; y++)
+			{
+				auto resultColumn = result.column(x, y);
+
+				for (int w = 0; w < box.wordsPerColumn; w++)
+				{
+					auto bits = segments[radius].word(w, x, y);
+
+					for (int i = -radius; i <= radius; i++)
+					{
+						for (int j = -radius; j <= radius; j++)
+						{
+							const auto squaredDistance = i * i + j * j;
+
+							if (squaredDistance == 0 || squaredDistance > radius * radius)
+							{
+								continue;
+							}
+
+							// Half length of the segment of the ball in the column
+							int h = 0;
+							while ((h + 1) * (h + 1) + squaredDistance <= radius * radius)
+							{
+								h++;
+							}
+
+							bits = combineWords(bits, segments[h].word(w, x + i, y + j), dilation);
+						}
+					}
+
+					resultColumn[w] = bits;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	/**
+	 * \brief Apply a dilation or an erosion on the words of bits of a voxel grid.
+	 *        Voxels outside of the grid are considered empty
+	 */
+	VoxelGrid applyMorphology(const VoxelGrid& grid, int kernelSize, StructuringElement element, bool dilation)
+	{
+		const auto kernelWidth = kernelSize / 2;
+
+		// Words are shifted by at most the width of the kernel along the Z axis
+		assert(kernelWidth >= 0 && kernelWidth < 64);
+
+		VoxelGrid newGrid(grid.boundingBox(), grid.resolutionX(), grid.resolutionY(), grid.resolutionZ(), grid.storage());
+
+		if (grid.empty())
+		{
+			return newGrid;
+		}
+
+		// Only columns in the box of voxels, enlarged by the kernel for a dilation, can have voxels after the operation
+		const auto voxelBox = grid.voxelBoundingBox();
+		const auto margin = dilation ? kernelWidth : 0;
+
+		const auto minX = std::max(voxelBox.first.x - margin, 0);
+		const auto minY = std::max(voxelBox.first.y - margin, 0);
+		const auto maxX = std::min(voxelBox.second.x + margin, grid.resolutionX() - 1);
+		const auto maxY = std::min(voxelBox.second.y + margin, grid.resolutionY() - 1);
+
+		WordBox box(minX, minY, maxX - minX + 1, maxY - minY + 1, grid.wordsPerColumn());
+
+		#pragma omp parallel for
+		for (int x = 0; x < box.sizeX; x++)
+		{
+			for (int y = 0; y < box.sizeY; y++)
+			{
+				for (int w = 0; w < box.wordsPerColumn; w++)
+				{
+					box.column(x, y)[w] = grid.word(w, minX + x, minY + y);
+				}
+			}
+		}
+
+		auto result = (element == StructuringElement::Sphere)
+			? morphologySphere(box, kernelWidth, dilation)
+			: morphologyZ(box, kernelWidth, dilation);
+
+		if (element == StructuringElement::Cube)
+		{
+			// The cube is the product of three segments, applied one after the other
+			result = morphologyXY(morphologyXY(result, kernelWidth, 0, 1, dilation), kernelWidth, 1, 0, dilation);
+		}
+		else if (element == StructuringElement::Cross)
+		{
+			// The cross is the union of three segments, applied to the same voxels
+			const auto resultY = morphologyXY(box, kernelWidth, 0, 1, dilation);
+			const auto resultX = morphologyXY(box, kernelWidth, 1, 0, dilation);
+
+			for (std::size_t i = 0; i < result.words.size(); i++)
+			{
+				result.words[i] = combineWords(result.words[i], combineWords(resultY.words[i], resultX.words[i], dilation), dilation);
+			}
+		}
+
+		// Empty words are skipped so that no brick is allocated in sparse grids
+		for (int x = 0; x < result.sizeX; x++)
+		{
+			for (int y = 0; y < result.sizeY; y++)
+			{
+				for (int w = 0; w < result.wordsPerColumn; w++)
+				{
+					const auto bits = result.column(x, y)[w];
+
+					if (bits != 0)
+					{
+						newGrid.setWord(w, minX + x, minY + y, bits);
+					}
+				}
+			}
+		}
+
+		return newGrid;
+	}
+
+	/**
+	 * \brief Number of columns on the X and Y axes of the bricks in which triangles are voxelized
+	 */
+	const int triangleBrickSize = 16;
+
+	/**
+	 * \brief Return the triangles of a mesh in the coordinates of a grid,
+	 *        where the voxel (x, y, z) is the box of center (x, y, z) and size 1
+	 */
+	std::vector<std::array<QVector3D, 3>> trianglesInGrid(
+		const VoxelGrid& grid,
+		const QMatrix4x4& worldMatrix,
+		const std::vector<QVector3D>& vertices,
+		const std::vector<std::tuple<int, int, int>>& faces)
+	{
+		const int numberFaces = int(faces.size());
+		const QVector3D scale(float(grid.resolutionX() - 1), float(grid.resolutionY() - 1), float(grid.resolutionZ() - 1));
+
+		std::vector<std::array<QVector3D, 3>> triangles(numberFaces);
+
+		#pragma omp parallel for
+		for (int i = 0; i < numberFaces; i++)
+		{
+			triangles[i] = { {
+				scale * grid.boundingBox().inverseLerp(worldMatrix.map(vertices[std::get<0>(faces[i])])),
+				scale * grid.boundingBox().inverseLerp(worldMatrix.map(vertices[std::get<1>(faces[i])])),
+				scale * grid.boundingBox().inverseLerp(worldMatrix.map(vertices[std::get<2>(faces[i])]))
+			} };
+		}
+
+		return triangles;
+	}
+
+	/**
+	 * \brief Return the range of voxels of an axis whose box overlaps a range of coordinates, clamped to the grid
+	 */
+	std::pair<int, int> voxelRange(float minimum, float maximum, int resolution)
+	{
+		return std::make_pair(
+			std::max(int(std::ceil(minimum - 0.5f)), 0),
+			std::min(int(std::floor(maximum + 0.5f)), resolution - 1)
+		);
+	}
+
+	/**
+	 * \brief Return the indices of the triangles overlapping each brick of columns, bricks are ordered by X and then Y
+	 */
+	std::vector<std::vector<int>> binTriangles(const VoxelGrid& grid, const std::vector<std::array<QVector3D, 3>>& triangles)
+	{
+		const auto bricksX = (grid.resolutionX() + triangleBrickSize - 1) / triangleBrickSize;
+		const auto bricksY = (grid.resolutionY() + triangleBrickSize - 1) / triangleBrickSize;
+
+		std::vector<std::vector<int>> brickTriangles(std::size_t(bricksX) * bricksY);
+
+		for (int i = 0; i < int(triangles.size()); i++)
+		{
+			const auto& t = triangles[i];
+
+			const auto rangeX = voxelRange(std::min({ t[0].x(), t[1].x(), t[2].x() }), std::max({ t[0].x(), t[1].x(), t[2].x() }), grid.resolutionX());
+			const auto rangeY = voxelRange(std::min({ t[0].y(), t[1].y(), t[2].y() }), std::max({ t[0].y(), t[1].y(), t[2].y() }), grid.resolutionY());
+
+			if (rangeX.first > rangeX.second || rangeY.first > rangeY.second)
+			{
+				continue;
+			}
+
+			for (int bx = rangeX.first / triangleBrickSize; bx <= rangeX.second / triangleBrickSize; bx++)
+			{
+				for (int by = rangeY.first / triangleBrickSize; by <= rangeY.second / triangleBrickSize; by++)
+				{
+					brickTriangles[std::size_t(bx) * bricksY + by].push_back(i);
+				}
+			}
+		}
+
+		return brickTriangles;
+	}
+
+	/**
+	 * \brief Add the words of bits of the columns of bricks to a grid, empty bricks have no words
+	 */
+	void addBrickWords(VoxelGrid& grid, const std::vector<std::vector<std::uint64_t>>& brickWords)
+	{
+		const auto bricksY = (grid.resolutionY() + triangleBrickSize - 1) / triangleBrickSize;
+		const auto wordsPerColumn = grid.wordsPerColumn();
+
+		for (int brick = 0; brick < int(brickWords.size()); brick++)
+		{
+			if (brickWords[brick].empty())
+			{
+				continue;
+			}
+
+			const auto brickX = (brick / bricksY) * triangleBrickSize;
+			const auto brickY = (brick % bricksY) * triangleBrickSize;
+
+			for (int x = brickX; x < std::min(brickX + triangleBrickSize, grid.resolutionX()); x++)
+			{
+				for (int y = brickY; y < std::min(brickY + triangleBrickSize, grid.resolutionY()); y++)
+				{
+					const auto column = &brickWords[brick][(std::size_t(x - brickX) * triangleBrickSize + (y - brickY)) * wordsPerColumn];
+
+					for (int w = 0; w < wordsPerColumn; w++)
+					{
+						if (column[w] != 0)
+						{
+							grid.setWord(w, x, y, grid.word(w, x, y) | column[w]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * \brief Compute where a ray along the Z axis crosses a triangle.
+	 *        A ray through an edge shared by two triangles crosses only one of them
+	 * \param triangle A triangle
+	 * \param x Coordinate of the ray on the X axis
+	 * \param y Coordinate of the ray on the Y axis
+	 * \param crossing Coordinate of the crossing on the Z axis, and 1 or -1 if the triangle is counterclockwise or clockwise from above
+	 * \return True if the ray crosses the triangle
+	 */
+	bool rayCrossesTriangle(const std::array<QVector3D, 3>& triangle, int x, int y, std::pair<double, int>& crossing)
+	{
+		// Twice the signed area of the triangle projected on the XY plane
+		const auto area = (double(triangle[1].x()) - triangle[0].x()) * (double(triangle[2].y()) - triangle[0].y())
+		                - (double(triangle[1].y()) - triangle[0].y()) * (double(triangle[2].x()) - triangle[0].x());
+
+		// Triangles parallel to the ray are not crossed
+		if (area == 0.0)
+		{
+			return false;
+		}
+
+		double weights[3];
+		for (int e = 0; e < 3; e++)
+		{
+			// Edge opposite to the vertex e, oriented counterclockwise
+			auto from = triangle[(e + 1) % 3];
+			auto to = triangle[(e + 2) % 3];
+			if (area < 0.0)
+			{
+				std::swap(from, to);
+			}
+
+			const auto dx = double(to.x()) - from.x();
+			const auto dy = double(to.y()) - from.y();
+
+			weights[e] = dx * (y - double(from.y())) - dy * (x - double(from.x()));
+
+			// On an edge, the ray only crosses the triangle on the left of the edge in the top-left rule
+			const auto topLeft = (dy < 0.0) || (dy == 0.0 && dx < 0.0);
+			if (weights[e] < 0.0 || (weights[e] == 0.0 && !topLeft))
+			{
+				return false;
+			}
+		}
+
+		const auto sum = weights[0] + weights[1] + weights[2];
+		crossing.first = (weights[0] * triangle[0].z() + weights[1] * triangle[1].z() + weights[2] * triangle[2].z()) / sum;
+		crossing.second = (area > 0.0) ? 1 : -1;
+
+		return true;
+	}
+
+	/**
+	 * \brief Extend the marked bits of a column to the whole runs of allowed bits containing them
+	 * \param marked Words of the column with marked bits, they must be allowed
+	 * \param allowed Words of the column with allowed bits
+	 * \param wordsPerColumn Number of words in the column
+	 */
+	void fillColumnRuns(std::uint64_t* marked, const std::uint64_t* allowed, int wordsPerColumn)
+	{
+		// Fill towards the top of the column, shifts of 1, 2, 4... bits propagate the marks through allowed bits
+		std::uint64_t carry = 0;
+		for (int w = 0; w < wordsPerColumn; w++)
+		{
+			auto generate = marked[w] | (carry & allowed[w]);
+			auto propagate = allowed[w];
+
+			for (int shift = 1; shift < 64; shift *= 2)
+			{
+				generate |= propagate & (generate << shift);
+				propagate &= propagate << shift;
+			}
+
+			marked[w] = generate;
+			carry = generate >> 63;
+		}
+
+		// Fill towards the bottom of the column
+		carry = 0;
+		for (int w = wordsPerColumn - 1; w >= 0; w--)
+		{
+			auto generate = marked[w] | (carry & allowed[w]);
+			auto propagate = allowed[w];
+
+			for (int shift = 1; shift < 64; shift *= 2)
+			{
+				generate |= propagate & (generate >> shift);
+				propagate &= propagate >> shift;
+			}
+
+			marked[w] = generate;
+			carry = (generate & 1) << 63;
+		}
+	}
+
+	/**
+	 * \brief Add the voxels whose box intersects a triangle, triangles are in the coordinates of the grid
+	 */
+	void voxelizeTriangles(VoxelGrid& grid, const std::vector<std::array<QVector3D, 3>>& triangles)
+	{
+		// Triangles are binned in bricks of columns, each brick is voxelized by one thread
+		const auto brickTriangles = binTriangles(grid, triangles);
+		const auto bricksY = (grid.resolutionY() + triangleBrickSize - 1) / triangleBrickSize;
+		const auto wordsPerColumn = grid.wordsPerColumn();
+
+		std::vector<std::vector<std::uint64_t>> brickWords(brickTriangles.size());
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int brick = 0; brick < int(brickTriangles.size()); brick++)
+		{
+			if (brickTriangles[brick].empty())
+			{
+				continue;
+			}
+
+			const auto brickX = (brick / bricksY) * triangleBrickSize;
+			const auto brickY = (brick % bricksY) * triangleBrickSize;
+
+			auto& words = brickWords[brick];
+			words.assign(std::size_t(triangleBrickSize) * triangleBrickSize * wordsPerColumn, 0);
+
+			for (const auto i : brickTriangles[brick])
+			{
+				const auto& t = triangles[i];
+				const auto normal = QVector3D::crossProduct(t[1] - t[0], t[2] - t[0]);
+
+				const auto rangeX = voxelRange(std::min({ t[0].x(), t[1].x(), t[2].x() }), std::max({ t[0].x(), t[1].x(), t[2].x() }), grid.resolutionX());
+				const auto rangeY = voxelRange(std::min({ t[0].y(), t[1].y(), t[2].y() }), std::max({ t[0].y(), t[1].y(), t[2].y() }), grid.resolutionY());
+				const auto rangeZ = voxelRange(std::min({ t[0].z(), t[1].z(), t[2].z() }), std::max({ t[0].z(), t[1].z(), t[2].z() }), grid.resolutionZ());
+
+				for (int x = std::max(rangeX.first, brickX); x <= std::min(rangeX.second, brickX + triangleBrickSize - 1); x++)
+				{
+					for (int y = std::max(rangeY.first, brickY); y <= std::min(rangeY.second, brickY + triangleBrickSize - 1); y++)
+					{
+						auto startZ = rangeZ.first;
+						auto endZ = rangeZ.second;
+
+						// Only test the voxels around the plane of the triangle in the column
+						if (std::abs(normal.z()) > 1e-6f * normal.length())
+						{
+							const auto centerZ = t[0].z() - (normal.x() * (x - t[0].x()) + normal.y() * (y - t[0].y())) / normal.z();
+							const auto extentZ = 0.5f * (std::abs(normal.x()) + std::abs(normal.y())) / std::abs(normal.z());
+
+							// One more voxel on both sides for rounding errors
+							startZ = std::max(startZ, int(std::floor(centerZ - extentZ - 0.5f)));
+							endZ = std::min(endZ, int(std::ceil(centerZ + extentZ + 0.5f)));
+						}
+
+						auto column = &words[(std::size_t(x - brickX) * triangleBrickSize + (y - brickY)) * wordsPerColumn];
+
+						for (int z = startZ; z <= endZ; z++)
+						{
+							if (triangleBoxIntersection(QVector3D(float(x), float(y), float(z)), QVector3D(0.5f, 0.5f, 0.5f), t[0], t[1], t[2]))
+							{
+								column[z >> 6] |= std::uint64_t(1) << (z & 63);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		addBrickWords(grid, brickWords);
+	}
+
+	/**
+	 * \brief Return the root of the set of an element, sets are merged by pointing their root to another root
+	 */
+	int findShell(std::vector<int>& parents, int element)
+	{
+		while (parents[element] != element)
+		{
+			parents[element] = parents[parents[element]];
+			element = parents[element];
+		}
+
+		return element;
+	}
+
+	/**
+	 * \brief Return true if the inside of the mesh is found by the winding number of rays: every edge is shared
+	 *        by exactly two faces going through it in opposite directions, and each shell of faces connected
+	 *        by their edges faces outward, enclosing a positive volume. An inward-facing shell, such as the inside
+	 *        of a hollow part, would bring the winding number back to zero inside the solid
+	 * \param triangles Triangles of the mesh in the coordinates of the grid, in the order of the faces
+	 * \param faces Triangles of the mesh
+	 */
+	bool hasOutwardClosedShells(const std::vector<std::array<QVector3D, 3>>& triangles, const std::vector<std::tuple<int, int, int>>& faces)
+	{
+		struct Edge
+		{
+			int first;
+			int second;
+			bool forward;
+			int face;
+
+			bool operator<(const Edge& other) const
+			{
+				return std::tie(first, second) < std::tie(other.first, other.second);
+			}
+
+			bool operator==(const Edge& other) const
+			{
+				return first == other.first && second == other.second;
+			}
+		};
+
+		const int numberFaces = int(faces.size());
+
+		std::vector<Edge> edges;
+		edges.reserve(3 * faces.size());
+
+		for (int f = 0; f < numberFaces; f++)
+		{
+			const int indices[3] = { std::get<0>(faces[f]), std::get<1>(faces[f]), std::get<2>(faces[f]) };
+
+			for (int k = 0; k < 3; k++)
+			{
+				const auto first = indices[k];
+				const auto second = indices[(k + 1) % 3];
+
+				edges.push_back({ std::min(first, second), std::max(first, second), first < second, f });
+			}
+		}
+
+		std::sort(edges.begin(), edges.end());
+
+		// Faces sharing an edge belong to the same shell
+		std::vector<int> parents(numberFaces);
+		std::iota(parents.begin(), parents.end(), 0);
+
+		// Equal edges are consecutive, each one must appear twice and in opposite directions
+		for (std::size_t i = 0; i < edges.size(); i += 2)
+		{
+			if (i + 1 >= edges.size() || !(edges[i] == edges[i + 1]) || (i + 2 < edges.size() && edges[i + 2] == edges[i]))
+			{
+				return false;
+			}
+
+			if (edges[i].forward == edges[i + 1].forward)
+			{
+				return false;
+			}
+
+			parents[findShell(parents, edges[i].face)] = findShell(parents, edges[i + 1].face);
+		}
+
+		// Signed volume of each shell, as the sum of the tetrahedra between the origin and its triangles
+		std::vector<double> volumes(numberFaces, 0.0);
+
+		for (int f = 0; f < numberFaces; f++)
+		{
+			const auto& t = triangles[f];
+
+			volumes[findShell(parents, f)] += QVector3D::dotProduct(t[0], QVector3D::crossProduct(t[1], t[2])) / 6.0;
+		}
+
+		for (int f = 0; f < numberFaces; f++)
+		{
+			if (parents[f] == f && volumes[f] <= 0.0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+VoxelGrid::VoxelGrid(const AABB& boundingBox,
+                     int resolutionX,
+                     int resolutionY,
+                     int resolutionZ,
+                     VoxelStorage storage) :
 	m_boundingBox(boundingBox),
 	m_resolutionX(resolutionX),
 	m_resolutionY(resolutionY),
 	m_resolutionZ(resolutionZ),
-	m_grid(std::size_t(resolutionX) * std::size_t(resolutionY) * std::size_t(resolutionZ), false)
+	m_storage(storage),
+	m_wordsPerColumn((resolutionZ + 63) / 64),
+	m_bricksX((resolutionX + 7) / 8),
+	m_bricksY((resolutionY + 7) / 8),
+	m_bricksZ((resolutionZ + 7) / 8),
+	m_pagesX((m_bricksX + 7) / 8),
+	m_pagesY((m_bricksY + 7) / 8),
+	m_pagesZ((m_bricksZ + 7) / 8),
+	m_voxelsValid(true)
 {
-	
+	if (m_storage == VoxelStorage::Dense)
+	{
+		m_bits.resize(std::size_t(resolutionX) * std::size_t(resolutionY) * std::size_t(m_wordsPerColumn), 0);
+	}
+	else
+	{
+		m_pageIndices.resize(std::size_t(m_pagesX) * std::size_t(m_pagesY) * std::size_t(m_pagesZ), -1);
+	}
+}
+
+VoxelGrid::VoxelGrid(const VoxelGrid& other) :
+	m_boundingBox(other.m_boundingBox),
+	m_resolutionX(other.m_resolutionX),
+	m_resolutionY(other.m_resolutionY),
+	m_resolutionZ(other.m_resolutionZ),
+	m_storage(other.m_storage),
+	m_wordsPerColumn(other.m_wordsPerColumn),
+	m_bits(other.m_bits),
+	m_bricksX(other.m_bricksX),
+	m_bricksY(other.m_bricksY),
+	m_bricksZ(other.m_bricksZ),
+	m_bricks(other.m_bricks),
+	m_pagesX(other.m_pagesX),
+	m_pagesY(other.m_pagesY),
+	m_pagesZ(other.m_pagesZ),
+	m_pageIndices(other.m_pageIndices),
+	m_pages(other.m_pages),
+	m_voxelsValid(false)
+{
+	// Another thread may be generating the list of voxels, it is only read once complete
+	if (other.m_voxelsValid.load(std::memory_order_acquire))
+	{
+		m_voxels = other.m_voxels;
+		m_blockRanks = other.m_blockRanks;
+		m_kdTree = std::atomic_load(&other.m_kdTree);
+		m_voxelsValid.store(true, std::memory_order_relaxed);
+	}
+}
+
+VoxelGrid::VoxelGrid(VoxelGrid&& other) :
+	m_boundingBox(other.m_boundingBox),
+	m_resolutionX(other.m_resolutionX),
+	m_resolutionY(other.m_resolutionY),
+	m_resolutionZ(other.m_resolutionZ),
+	m_storage(other.m_storage),
+	m_wordsPerColumn(other.m_wordsPerColumn),
+	m_bits(std::move(other.m_bits)),
+	m_bricksX(other.m_bricksX),
+	m_bricksY(other.m_bricksY),
+	m_bricksZ(other.m_bricksZ),
+	m_bricks(std::move(other.m_bricks)),
+	m_pagesX(other.m_pagesX),
+	m_pagesY(other.m_pagesY),
+	m_pagesZ(other.m_pagesZ),
+	m_pageIndices(std::move(other.m_pageIndices)),
+	m_pages(std::move(other.m_pages)),
+	m_voxels(std::move(other.m_voxels)),
+	m_voxelsValid(other.m_voxelsValid.load(std::memory_order_relaxed)),
+	m_blockRanks(std::move(other.m_blockRanks)),
+	m_kdTree(std::move(other.m_kdTree))
+{
+
+}
+
+VoxelGrid& VoxelGrid::operator=(const VoxelGrid& other)
+{
+	if (this != &other)
+	{
+		*this = VoxelGrid(other);
+	}
+
+	return *this;
+}
+
+VoxelGrid& VoxelGrid::operator=(VoxelGrid&& other)
+{
+	m_boundingBox = other.m_boundingBox;
+	m_resolutionX = other.m_resolutionX;
+	m_resolutionY = other.m_resolutionY;
+	m_resolutionZ = other.m_resolutionZ;
+	m_storage = other.m_storage;
+	m_wordsPerColumn = other.m_wordsPerColumn;
+	m_bits = std::move(other.m_bits);
+	m_bricksX = other.m_bricksX;
+	m_bricksY = other.m_bricksY;
+	m_bricksZ = other.m_bricksZ;
+	m_bricks = std::move(other.m_bricks);
+	m_pagesX = other.m_pagesX;
+	m_pagesY = other.m_pagesY;
+	m_pagesZ = other.m_pagesZ;
+	m_pageIndices = std::move(other.m_pageIndices);
+	m_pages = std::move(other.m_pages);
+	m_voxels = std::move(other.m_voxels);
+	m_voxelsValid.store(other.m_voxelsValid.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	m_blockRanks = std::move(other.m_blockRanks);
+	m_kdTree = std::move(other.m_kdTree);
+
+	return *this;
 }
 
 const AABB& VoxelGrid::boundingBox() const
@@ -45,6 +841,11 @@ int VoxelGrid::resolutionZ() const
 	return m_resolutionZ;
 }
 
+VoxelStorage VoxelGrid::storage() const
+{
+	return m_storage;
+}
+
 float VoxelGrid::voxelSizeX() const
 {
 	return m_boundingBox.sizeX() / float(m_resolutionX);
@@ -62,16 +863,25 @@ float VoxelGrid::voxelSizeZ() const
 
 void VoxelGrid::clear()
 {
-	m_voxels.clear();
+	std::fill(m_bits.begin(), m_bits.end(), 0);
+
+	// Release all bricks
+	std::fill(m_pageIndices.begin(), m_pageIndices.end(), -1);
+	std::vector<BrickPage>().swap(m_pages);
+	std::vector<Brick>().swap(m_bricks);
 
-	std::fill(m_grid.begin(), m_grid.end(), false);
+	// The grid is empty, voxelNumber has no voxel to look up
+	m_voxels.clear();
+	std::vector<std::uint32_t>().swap(m_blockRanks);
+	m_kdTree.reset();
+	m_voxelsValid.store(true, std::memory_order_relaxed);
 }
 
 void VoxelGrid::saveAsOBJ(const std::string& filename) const
 {
 	OBJWriter obj;
 
-	for (const auto& v : m_voxels)
+	for (const auto& v : voxels())
 	{
 		const auto point = voxel(v);
 		obj.addVertex(point);
@@ -88,9 +898,14 @@ OBJWriter VoxelGrid::getVoxelsAsOBJ(bool keepSurfaceOnly) const
 
 	OBJWriter obj;
 
-	for (const auto& v : m_voxels)
+	// Neighbors of all voxels are counted at once
+	const auto neighbors = keepSurfaceOnly ? computeNumberNeighbors(*this) : std::vector<std::uint8_t>();
+
+	for (std::size_t i = 0; i < voxels().size(); i++)
 	{
-		if (!keepSurfaceOnly || numberNeighbors(v.x, v.y, v.z) < 26)
+		const auto& v = voxels()[i];
+
+		if (!keepSurfaceOnly || neighbors[i] < 26)
 		{
 			const auto center = voxel(v);
 
@@ -200,48 +1015,407 @@ Voxel VoxelGrid::voxelFromIndex(std::size_t index) const
 	return v;
 }
 
-const std::vector<Voxel>& VoxelGrid::voxels() const
-{
-	return m_voxels;
-}
+const std::vector<Voxel>& VoxelGrid::voxels() const
+{
+	updateVoxels();
+
+	return m_voxels;
+}
+
+std::size_t VoxelGrid::numberVoxels() const
+{
+	if (m_voxelsValid.load(std::memory_order_acquire))
+	{
+		return m_voxels.size();
+	}
+
+	std::size_t numberVoxels = 0;
+
+	for (const auto bits : m_bits)
+	{
+		numberVoxels += countBits(bits);
+	}
+
+	for (const auto& brick : m_bricks)
+	{
+		for (const auto bits : brick)
+		{
+			numberVoxels += countBits(bits);
+		}
+	}
+
+	return numberVoxels;
+}
+
+bool VoxelGrid::empty() const
+{
+	if (m_voxelsValid.load(std::memory_order_acquire))
+	{
+		return m_voxels.empty();
+	}
+
+	const auto isEmpty = [](std::uint64_t bits) { return bits == 0; };
+
+	if (!std::all_of(m_bits.begin(), m_bits.end(), isEmpty))
+	{
+		return false;
+	}
+
+	// Bricks may have been emptied after their allocation
+	for (const auto& brick : m_bricks)
+	{
+		if (!std::all_of(brick.begin(), brick.end(), isEmpty))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void VoxelGrid::sortVoxels()
+{
+	updateVoxels();
+}
+
+int VoxelGrid::voxelNumber(int x, int y, int z) const
+{
+	if (!hasVoxel(x, y, z))
+	{
+		return -1;
+	}
+
+	const auto& voxels = this->voxels();
+
+	if (m_storage == VoxelStorage::Sparse)
+	{
+		const auto it = std::lower_bound(voxels.begin(), voxels.end(), Voxel(x, y, z));
+
+		return int(std::distance(voxels.begin(), it));
+	}
+
+	// The list is in the order of the bits, the index is the number of bits set before the voxel
+	const auto index = (std::size_t(x) * m_resolutionY + y) * m_wordsPerColumn + (z >> 6);
+	assert((index >> 3) < m_blockRanks.size());
+
+	auto rank = std::size_t(m_blockRanks[index >> 3]);
+
+	for (auto i = index & ~std::size_t(7); i < index; i++)
+	{
+		rank += countBits(m_bits[i]);
+	}
+
+	rank += countBits(m_bits[index] & ((std::uint64_t(1) << (z & 63)) - 1));
+
+	return int(rank);
+}
+
+void VoxelGrid::add(int x, int y, int z)
+{
+	assert(x >= 0);
+	assert(y >= 0);
+	assert(z >= 0);
+
+	assert(x < m_resolutionX);
+	assert(y < m_resolutionY);
+	assert(z < m_resolutionZ);
+
+	const auto bits = word(z >> 6, x, y);
+	const auto mask = std::uint64_t(1) << (z & 63);
+
+	if ((bits & mask) == 0)
+	{
+		writeWord(z >> 6, x, y, bits | mask);
+	}
+}
+
+void VoxelGrid::addRange(int x, int y, int startZ, int endZ)
+{
+	assert(x >= 0 && x < m_resolutionX);
+	assert(y >= 0 && y < m_resolutionY);
+	assert(startZ >= 0 && endZ <= m_resolutionZ);
+
+	for (int z = startZ; z < endZ; z = (z | 63) + 1)
+	{
+		const auto mask = rangeMask(z & 63, std::min(endZ - (z & ~63), 64));
+
+		writeWord(z >> 6, x, y, word(z >> 6, x, y) | mask);
+	}
+}
+
+void VoxelGrid::removeRange(int x, int y, int startZ, int endZ)
+{
+	assert(x >= 0 && x < m_resolutionX);
+	assert(y >= 0 && y < m_resolutionY);
+	assert(startZ >= 0 && endZ <= m_resolutionZ);
+
+	for (int z = startZ; z < endZ; z = (z | 63) + 1)
+	{
+		const auto mask = rangeMask(z & 63, std::min(endZ - (z & ~63), 64));
+
+		writeWord(z >> 6, x, y, word(z >> 6, x, y) & ~mask);
+	}
+}
+
+void VoxelGrid::setWord(int index, int x, int y, std::uint64_t bits)
+{
+	assert(index >= 0 && index < m_wordsPerColumn);
+	assert(x >= 0 && x < m_resolutionX);
+	assert(y >= 0 && y < m_resolutionY);
+
+	// Keep the bits after the end of the column to zero
+	bits &= rangeMask(0, std::min(m_resolutionZ - 64 * index, 64));
+
+	writeWord(index, x, y, bits);
+}
+
+void VoxelGrid::setVoxels(std::vector<Voxel> voxels)
+{
+	assert(std::is_sorted(voxels.begin(), voxels.end()));
+	assert(std::adjacent_find(voxels.begin(), voxels.end()) == voxels.end());
+
+	clear();
+
+	for (const auto& v : voxels)
+	{
+		if (m_storage == VoxelStorage::Dense)
+		{
+			m_bits[(std::size_t(v.x) * m_resolutionY + v.y) * m_wordsPerColumn + (v.z >> 6)] |= std::uint64_t(1) << (v.z & 63);
+		}
+		else
+		{
+			writeWord(v.z >> 6, v.x, v.y, word(v.z >> 6, v.x, v.y) | (std::uint64_t(1) << (v.z & 63)));
+		}
+	}
+
+	m_voxels = std::move(voxels);
+	m_voxelsValid.store(true, std::memory_order_relaxed);
+
+	updateBlockRanks();
+}
+
+int VoxelGrid::brickIndex(int brickX, int brickY, int brickZ) const
+{
+	const auto page = m_pageIndices[(std::size_t(brickX >> 3) * m_pagesY + (brickY >> 3)) * m_pagesZ + (brickZ >> 3)];
+
+	if (page < 0)
+	{
+		return -1;
+	}
+
+	return m_pages[page][((brickX & 7) * 8 + (brickY & 7)) * 8 + (brickZ & 7)];
+}
+
+int VoxelGrid::allocateBrick(int brickX, int brickY, int brickZ)
+{
+	auto& page = m_pageIndices[(std::size_t(brickX >> 3) * m_pagesY + (brickY >> 3)) * m_pagesZ + (brickZ >> 3)];
+
+	if (page < 0)
+	{
+		page = int(m_pages.size());
+
+		m_pages.emplace_back();
+		m_pages.back().fill(-1);
+	}
+
+	auto& brick = m_pages[page][((brickX & 7) * 8 + (brickY & 7)) * 8 + (brickZ & 7)];
+
+	if (brick < 0)
+	{
+		brick = int(m_bricks.size());
+		m_bricks.push_back(Brick());
+	}
+
+	return brick;
+}
+
+std::uint64_t VoxelGrid::sparseWord(int index, int x, int y) const
+{
+	const auto shift = 8 * (y & 7);
+
+	std::uint64_t bits = 0;
+
+	// Each brick holds 8 bits of the word
+	for (int k = 0; k < 8 && 8 * index + k < m_bricksZ; k++)
+	{
+		const auto brick = brickIndex(x >> 3, y >> 3, 8 * index + k);
+
+		if (brick >= 0)
+		{
+			bits |= ((m_bricks[brick][x & 7] >> shift) & 0xff) << (8 * k);
+		}
+	}
+
+	return bits;
+}
+
+void VoxelGrid::writeWord(int index, int x, int y, std::uint64_t bits)
+{
+	if (m_storage == VoxelStorage::Dense)
+	{
+		auto& word = m_bits[(std::size_t(x) * m_resolutionY + y) * m_wordsPerColumn + index];
+
+		if (word != bits)
+		{
+			word = bits;
+
+			invalidateVoxels();
+		}
+
+		return;
+	}
+
+	const auto shift = 8 * (y & 7);
+
+	for (int k = 0; k < 8 && 8 * index + k < m_bricksZ; k++)
+	{
+		const auto byte = (bits >> (8 * k)) & 0xff;
+		auto brick = brickIndex(x >> 3, y >> 3, 8 * index + k);
+
+		if (brick < 0)
+		{
+			// Empty bricks are only allocated when voxels are added in them
+			if (byte == 0)
+			{
+				continue;
+			}
+
+			brick = allocateBrick(x >> 3, y >> 3, 8 * index + k);
+		}
+
+		auto& brickWord = m_bricks[brick][x & 7];
+		const auto newWord = (brickWord & ~(std::uint64_t(0xff) << shift)) | (byte << shift);
+
+		if (brickWord != newWord)
+		{
+			brickWord = newWord;
+
+			invalidateVoxels();
+		}
+	}
+}
+
+void VoxelGrid::updateVoxels() const
+{
+	// Acquire pairs with the release below: a thread seeing the flag set also sees the complete list
+	if (m_voxelsValid.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	// The list may be requested by several threads reading the grid
+	#pragma omp critical(voxel_grid_update_voxels)
+	{
+		if (!m_voxelsValid.load(std::memory_order_relaxed))
+		{
+			m_voxels.reserve(numberVoxels());
+
+			if (m_storage == VoxelStorage::Dense)
+			{
+				// Columns are stored in the order of voxels, the list is sorted
+				for (std::size_t column = 0; column < std::size_t(m_resolutionX) * m_resolutionY; column++)
+				{
+					const int x = int(column / m_resolutionY);
+					const int y = int(column % m_resolutionY);
+
+					for (int w = 0; w < m_wordsPerColumn; w++)
+					{
+						auto bits = m_bits[column * m_wordsPerColumn + w];
+
+						while (bits != 0)
+						{
+							m_voxels.emplace_back(x, y, 64 * w + lowestBit(bits));
+
+							// Clear the lowest set bit
+							bits &= bits - 1;
+						}
+					}
+				}
+
+				updateBlockRanks();
+			}
+			else
+			{
+				// Allocated bricks of each column of bricks in a slab of bricks along X
+				std::vector<std::vector<std::pair<int, int>>> columnBricks(m_bricksY);
+
+				for (int bx = 0; bx < m_bricksX; bx++)
+				{
+					for (int by = 0; by < m_bricksY; by++)
+					{
+						columnBricks[by].clear();
+
+						for (int bz = 0; bz < m_bricksZ; bz++)
+						{
+							const auto brick = brickIndex(bx, by, bz);
+
+							if (brick >= 0)
+							{
+								columnBricks[by].emplace_back(bz, brick);
+							}
+						}
+					}
+
+					// Visit voxels of the slab in increasing order
+					for (int x = 8 * bx; x < std::min(8 * bx + 8, m_resolutionX); x++)
+					{
+						for (int by = 0; by < m_bricksY; by++)
+						{
+							for (int y = 8 * by; y < std::min(8 * by + 8, m_resolutionY); y++)
+							{
+								for (const auto& brick : columnBricks[by])
+								{
+									auto bits = (m_bricks[brick.second][x & 7] >> (8 * (y & 7))) & 0xff;
+
+									while (bits != 0)
+									{
+										m_voxels.emplace_back(x, y, 8 * brick.first + lowestBit(bits));
 
-bool VoxelGrid::empty() const
-{
-	return m_voxels.empty();
-}
+										// Clear the lowest set bit
+										bits &= bits - 1;
+									}
+								}
+							}
+						}
+					}
+				}
+			}
 
-void VoxelGrid::sortVoxels()
-{
-	std::sort(m_voxels.begin(), m_voxels.end());
+			m_voxelsValid.store(true, std::memory_order_release);
+		}
+	}
 }
 
-int VoxelGrid::voxelNumber(int x, int y, int z) const
+void VoxelGrid::updateBlockRanks() const
 {
-	const auto it = std::lower_bound(m_voxels.begin(), m_voxels.end(), Voxel(x, y, z));
-
-	if (it != m_voxels.end())
+	if (m_storage != VoxelStorage::Dense)
 	{
-		return std::distance(m_voxels.begin(), it);
+		return;
 	}
 
-	return -1;
-}
+	m_blockRanks.resize((m_bits.size() + 7) / 8);
 
-void VoxelGrid::add(int x, int y, int z)
-{
-	assert(x >= 0);
-	assert(y >= 0);
-	assert(z >= 0);
+	std::uint32_t rank = 0;
+	for (std::size_t i = 0; i < m_bits.size(); i++)
+	{
+		if ((i & 7) == 0)
+		{
+			m_blockRanks[i >> 3] = rank;
+		}
 
-	assert(x < m_resolutionX);
-	assert(y < m_resolutionY);
-	assert(z < m_resolutionZ);
+		rank += countBits(m_bits[i]);
+	}
+}
 
-	if (!hasVoxel(x, y, z))
+void VoxelGrid::invalidateVoxels()
+{
+	if (m_voxelsValid.load(std::memory_order_relaxed))
 	{
-		m_grid[voxelIndex(x, y, z)] = true;
-
-		m_voxels.emplace_back(x, y, z);
+		// Release the memory of the list and its index, the bits are enough until the list is requested again
+		std::vector<Voxel>().swap(m_voxels);
+		std::vector<std::uint32_t>().swap(m_blockRanks);
+		m_kdTree.reset();
+		m_voxelsValid.store(false, std::memory_order_relaxed);
 	}
 }
 
@@ -250,7 +1424,14 @@ bool VoxelGrid::hasVoxel(int x, int y, int z) const
 	if (x >= 0 && y >= 0 && z >= 0
 	 && x < m_resolutionX && y < m_resolutionY && z < m_resolutionZ)
 	{
-		return m_grid[voxelIndex(x, y, z)];
+		if (m_storage == VoxelStorage::Dense)
+		{
+			return (m_bits[(std::size_t(x) * m_resolutionY + y) * m_wordsPerColumn + (z >> 6)] >> (z & 63)) & 1;
+		}
+
+		const auto brick = brickIndex(x >> 3, y >> 3, z >> 3);
+
+		return brick >= 0 && ((m_bricks[brick][x & 7] >> (8 * (y & 7) + (z & 7))) & 1);
 	}
 	else
 	{
@@ -333,37 +1514,48 @@ bool VoxelGrid::isVoxelInsideGrid(const Voxel& voxel) const
 		&& (voxel.z >= 0 && voxel.z < m_resolutionZ);
 }
 
-QVector3D VoxelGrid::nearestVoxel(const QVector3D& query) const
+const VoxelKdTree& VoxelGrid::kdTree() const
 {
-	float minimumDistanceSq = std::numeric_limits<float>::max();
-	QVector3D nearestPoint;
-	
-	for (const auto& v : m_voxels)
-	{
-		const auto point = voxel(v);
-
-		const float distSq = distanceSquared(query, point);
+	// The tree may be requested by several threads reading the grid, the pointer is only accessed atomically
+	auto tree = std::atomic_load(&m_kdTree);
 
-		if (distSq < minimumDistanceSq)
+	if (!tree)
+	{
+		#pragma omp critical(voxel_grid_update_kd_tree)
 		{
-			minimumDistanceSq = distSq;
-			nearestPoint = point;
+			tree = std::atomic_load(&m_kdTree);
+
+			if (!tree)
+			{
+				tree = std::make_shared<const VoxelKdTree>(*this, voxels());
+				std::atomic_store(&m_kdTree, tree);
+			}
 		}
 	}
 
-	return nearestPoint;
+	return *tree;
+}
+
+QVector3D VoxelGrid::nearestVoxel(const QVector3D& query) const
+{
+	const auto& tree = kdTree();
+	const auto index = tree.nearest(query);
+
+	return (index >= 0) ? tree.point(index) : QVector3D();
 }
 
 QVector3D VoxelGrid::nearestVoxelWithActiveSet(const QVector3D& query, const std::vector<int>& activeVoxels) const
 {
+	const auto& voxels = this->voxels();
+
 	float minimumDistanceSq = std::numeric_limits<float>::max();
 	QVector3D nearestPoint;
 
 	for (auto voxelIndex : activeVoxels)
 	{
-		assert(voxelIndex >= 0 && voxelIndex < m_voxels.size());
+		assert(voxelIndex >= 0 && voxelIndex < voxels.size());
 
-		const auto point = voxel(m_voxels[voxelIndex]);
+		const auto point = voxel(voxels[voxelIndex]);
 
 		const float distSq = distanceSquared(query, point);
 
@@ -387,16 +1579,81 @@ std::pair<Voxel, Voxel> VoxelGrid::voxelBoundingBox() const
 	int minY = m_resolutionY;
 	int minZ = m_resolutionZ;
 	
-	// #pragma omp parallel for reduction(min:minX, minY, minZ) reduction(max:maxX, maxY, maxZ)
-	for (int i = 0; i < m_voxels.size(); i++)
+	if (m_storage == VoxelStorage::Sparse)
+	{
+		for (int bx = 0; bx < m_bricksX; bx++)
+		{
+			for (int by = 0; by < m_bricksY; by++)
+			{
+				for (int bz = 0; bz < m_bricksZ; bz++)
+				{
+					const auto brick = brickIndex(bx, by, bz);
+
+					if (brick < 0)
+					{
+						continue;
+					}
+
+					for (int i = 0; i < 8; i++)
+					{
+						const auto bits = m_bricks[brick][i];
+
+						if (bits == 0)
+						{
+							continue;
+						}
+
+						// Merge the 8 columns of the word to find occupied coordinates on the Z axis
+						auto columns = bits | (bits >> 32);
+						columns |= columns >> 16;
+						columns |= columns >> 8;
+						columns &= 0xff;
+
+						minX = std::min(minX, 8 * bx + i);
+						minY = std::min(minY, 8 * by + lowestBit(bits) / 8);
+						minZ = std::min(minZ, 8 * bz + lowestBit(columns));
+
+						maxX = std::max(maxX, 8 * bx + i);
+						maxY = std::max(maxY, 8 * by + highestBit(bits) / 8);
+						maxZ = std::max(maxZ, 8 * bz + highestBit(columns));
+					}
+				}
+			}
+		}
+
+		return std::make_pair(Voxel(minX, minY, minZ), Voxel(maxX, maxY, maxZ));
+	}
+
+	// Only the first and last non-empty words of each column are needed
+	for (int x = 0; x < m_resolutionX; x++)
 	{
-		minX = std::min(minX, m_voxels[i].x);
-		minY = std::min(minY, m_voxels[i].y);
-		minZ = std::min(minZ, m_voxels[i].z);
+		for (int y = 0; y < m_resolutionY; y++)
+		{
+			int first = 0;
+			while (first < m_wordsPerColumn && word(first, x, y) == 0)
+			{
+				first++;
+			}
+
+			if (first == m_wordsPerColumn)
+			{
+				continue;
+			}
+
+			int last = m_wordsPerColumn - 1;
+			while (word(last, x, y) == 0)
+			{
+				last--;
+			}
+
+			minX = std::min(minX, x);
+			minY = std::min(minY, y);
+			minZ = std::min(minZ, 64 * first + lowestBit(word(first, x, y)));
 
-		maxX = std::max(maxX, m_voxels[i].x);
-		maxY = std::max(maxY, m_voxels[i].y);
-		maxZ = std::max(maxZ, m_voxels[i].z);
+			maxX = std::max(maxX, x);
+			maxY = std::max(maxY, y);
+			maxZ = std::max(maxZ, 64 * last + highestBit(word(last, x, y)));
+		}
 	}
 
 	return std::make_pair(Voxel(minX, minY, minZ), Voxel(maxX, maxY, maxZ));
@@ -417,10 +1674,10 @@ VoxelGrid VoxelGrid::optimized() const
 	const int resolutionZ = 1 + box.second.z - box.first.z;
 
 	// Create a new voxel grid
-	VoxelGrid newGrid(newBoundingBox, resolutionX, resolutionY, resolutionZ);
+	VoxelGrid newGrid(newBoundingBox, resolutionX, resolutionY, resolutionZ, m_storage);
 
 	// Copy vector and offset
-	for (const auto voxel : m_voxels)
+	for (const auto voxel : voxels())
 	{
 		newGrid.add(
 			voxel.x - box.first.x,
@@ -443,10 +1700,10 @@ void VoxelGrid::exportVoxels(const std::string& filename) const
 	}
 
 	// Write the total number of voxels in the file
-	file << m_voxels.size() << "\n";
+	file << numberVoxels() << "\n";
 	
 	// Export the voxels
-	for (const auto& v : m_voxels)
+	for (const auto& v : voxels())
 	{
 		file << v.x << " " << v.y << " " << v.z << "\n";
 	}
@@ -509,7 +1766,6 @@ void VoxelGrid::importVoxels(const std::string& filename)
 
 	// Allocation de la grille
 	clear();
-	m_voxels.reserve(numberVoxels);
 
 	// Import the voxels
 	for (int i = 0; i < numberVoxels; i++)
@@ -602,314 +1858,259 @@ void drawCubeInGrid(
 
 long long countNumberSurfaceVoxels(const VoxelGrid& grid)
 {
-	const auto& voxels = grid.voxels();
-	
-	long long numberSurfaceVoxels = 0;
+	return countNumberVoxelsByNeighbors(grid, 0, 25);
+}
 
-	#pragma omp parallel for shared(numberSurfaceVoxels)
-	for (int i = 0; i < voxels.size(); i++)
-	{
-		const auto v = voxels[i];
-		
-		if (grid.numberNeighbors(v.x, v.y, v.z) < 26)
-		{
-			#pragma omp atomic
-			numberSurfaceVoxels++;
-		}
-	}
+VoxelGrid morphingDilation(const VoxelGrid& grid, int kernelSize, StructuringElement element)
+{
+	return applyMorphology(grid, kernelSize, element, true);
+}
+
+VoxelGrid morphingErosion(const VoxelGrid& grid, int kernelSize, StructuringElement element)
+{
+	return applyMorphology(grid, kernelSize, element, false);
+}
+
+void voxelizeMesh(
+	VoxelGrid& grid,
+	const QMatrix4x4& worldMatrix,
+	const std::vector<QVector3D>& vertices,
+	const std::vector<std::tuple<int, int, int>>& faces)
+{
+	const auto triangles = trianglesInGrid(grid, worldMatrix, vertices, faces);
 
-	return numberSurfaceVoxels;
+	voxelizeTriangles(grid, triangles);
 }
 
-VoxelGrid morphingDilation(const VoxelGrid& grid, int kernelSize)
+void voxelizeSolidMesh(
+	VoxelGrid& grid,
+	const QMatrix4x4& worldMatrix,
+	const std::vector<QVector3D>& vertices,
+	const std::vector<std::tuple<int, int, int>>& faces)
 {
-	const auto kernelWidth = kernelSize / 2;
-	
-	VoxelGrid newGrid(grid.boundingBox(), grid.resolutionX(), grid.resolutionY(), grid.resolutionZ());
+	const auto triangles = trianglesInGrid(grid, worldMatrix, vertices, faces);
 
-	#pragma omp parallel for collapse(3)
-	for (int x = 0; x < grid.resolutionX(); x++)
+	// Voxels crossed by the surface
+	voxelizeTriangles(grid, triangles);
+
+	// Rays only find the inside of closed shells facing outward: between open surfaces, such as leaves stacked
+	// above each other, crossings come in pairs around empty space, and inward-facing shells cancel the winding
+	// number of the shells around them. Otherwise cavities enclosed by the surface are filled
+	if (!hasOutwardClosedShells(triangles, faces))
 	{
-		for (int y = 0; y < grid.resolutionY(); y++)
-		{
-			for (int z = 0; z < grid.resolutionZ(); z++)
-			{
-				bool dilateHere = false;
-				
-				// Apply kernel
-				for (int i = -kernelWidth; i <= kernelWidth && !dilateHere; i++)
-				{
-					for (int j = -kernelWidth; j <= kernelWidth && !dilateHere; j++)
-					{
-						for (int k = -kernelWidth; k <= kernelWidth && !dilateHere; k++)
-						{
-							const auto vx = clamp(x + i, 0, grid.resolutionX() - 1);
-							const auto vy = clamp(y + j, 0, grid.resolutionY() - 1);
-							const auto vz = clamp(z + k, 0, grid.resolutionZ() - 1);
+		fillCavitiesInGrid(grid);
+		return;
+	}
 
-							if (vx != x || vy != y || vz != z)
-							{
-								if (grid.hasVoxel(vx, vy, vz))
-								{
-									// Keep the voxel(x, y, z)
-									dilateHere = true;
-								}
-							}
-						}
-					}
-				}
+	// Crossings outside of the grid on the Z axis still count for the parity, triangles are only binned on X and Y
+	const auto brickTriangles = binTriangles(grid, triangles);
+	const auto bricksY = (grid.resolutionY() + triangleBrickSize - 1) / triangleBrickSize;
+	const auto wordsPerColumn = grid.wordsPerColumn();
 
-				// If at least one voxel is in the kernel
-				if (dilateHere)
-				{
-					// Keep the voxel (x, y, z)
-					#pragma omp critical(dilation_add_voxel)
-					{
-						newGrid.add(x, y, z);
-					}
-				}
-			}
+	std::vector<std::vector<std::uint64_t>> brickWords(brickTriangles.size());
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int brick = 0; brick < int(brickTriangles.size()); brick++)
+	{
+		if (brickTriangles[brick].empty())
+		{
+			continue;
 		}
-	}
 
-	return newGrid;
-}
+		const auto brickX = (brick / bricksY) * triangleBrickSize;
+		const auto brickY = (brick % bricksY) * triangleBrickSize;
 
-VoxelGrid morphingErosion(const VoxelGrid& grid, int kernelSize)
-{
-	const auto kernelWidth = kernelSize / 2;
+		auto& words = brickWords[brick];
+		words.assign(std::size_t(triangleBrickSize) * triangleBrickSize * wordsPerColumn, 0);
 
-	VoxelGrid newGrid(grid.boundingBox(), grid.resolutionX(), grid.resolutionY(), grid.resolutionZ());
+		std::vector<std::pair<double, int>> crossings;
 
-	#pragma omp parallel for collapse(3)
-	for (int x = kernelWidth; x < grid.resolutionX() - kernelWidth; x++)
-	{
-		for (int y = kernelWidth; y < grid.resolutionY() - kernelWidth; y++)
+		for (int x = brickX; x < std::min(brickX + triangleBrickSize, grid.resolutionX()); x++)
 		{
-			for (int z = kernelWidth; z < grid.resolutionZ() - kernelWidth; z++)
+			for (int y = brickY; y < std::min(brickY + triangleBrickSize, grid.resolutionY()); y++)
 			{
-				bool erodeHere = true;
-
-				// Apply kernel
-				for (int i = -kernelWidth; i <= kernelWidth && erodeHere; i++)
+				// Cast a ray along the Z axis through the centers of the voxels of the column
+				crossings.clear();
+				int winding = 0;
+				for (const auto i : brickTriangles[brick])
 				{
-					for (int j = -kernelWidth; j <= kernelWidth && erodeHere; j++)
+					std::pair<double, int> crossing;
+					if (rayCrossesTriangle(triangles[i], x, y, crossing))
 					{
-						for (int k = -kernelWidth; k <= kernelWidth && erodeHere; k++)
-						{
-							const auto vx = clamp(x + i, 0, grid.resolutionX() - 1);
-							const auto vy = clamp(y + j, 0, grid.resolutionY() - 1);
-							const auto vz = clamp(z + k, 0, grid.resolutionZ() - 1);
-
-							if (vx != x || vy != y || vz != z)
-							{
-								if (!grid.hasVoxel(vx, vy, vz))
-								{
-									// Keep the voxel(x, y, z)
-									erodeHere = false;
-								}
-							}
-						}
+						crossings.push_back(crossing);
+						winding += crossing.second;
 					}
 				}
 
-				// If all voxels are in the kernel
-				if (erodeHere)
+				// The mesh is not closed around this column, only its surface is kept
+				if (crossings.size() % 2 != 0)
 				{
-					// Keep the voxel (x, y, z)
-					#pragma omp critical(erosion_add_voxel)
-					{
-						newGrid.add(x, y, z);
-					}
+					continue;
 				}
-			}
-		}
-	}
 
-	return newGrid;
-}
+				std::sort(crossings.begin(), crossings.end());
 
-void voxelizeMesh(
-	VoxelGrid& grid,
-	const QMatrix4x4& worldMatrix,
-	const std::vector<QVector3D>& vertices,
-	const std::vector<std::tuple<int, int, int>>& faces)
-{	
-	for (unsigned int i = 0; i < faces.size(); i++)
-	{
-		const auto vertex1 = worldMatrix.map(vertices[std::get<0>(faces[i])]);
-		const auto vertex2 = worldMatrix.map(vertices[std::get<1>(faces[i])]);
-		const auto vertex3 = worldMatrix.map(vertices[std::get<2>(faces[i])]);
-
-		// Compute larger side of triangle
-		const auto largerSide = std::max({
-			vertex1.distanceToPoint(vertex2),
-			vertex1.distanceToPoint(vertex3),
-			vertex2.distanceToPoint(vertex3)
-		});
-
-		const auto minVoxelSize = std::min({
-			grid.voxelSizeX(),
-			grid.voxelSizeY(),
-			grid.voxelSizeZ()
-		});
-
-		// Compute the sampling resolution so that the larger side is sampled with
-		// Twenty times more points evenly spaced than the resolution of the voxel grid
-		// Oversampling to be sure that we get all the voxels
-		const auto samplingResolution = int(std::ceil(20.0 * largerSide / minVoxelSize));
-
-		// Sample points on this triangle		
-		for (int j = 0; j < samplingResolution; j++)
-		{
-			for (int k = 0; k < samplingResolution; k++)
-			{
-				const auto u = float(j) / (samplingResolution - 1);
-				const auto v = float(k) / (samplingResolution - 1);
+				auto column = &words[(std::size_t(x - brickX) * triangleBrickSize + (y - brickY)) * wordsPerColumn];
 
-				if (1.0f - u - v >= 0.0f)
+				// Shells facing outward give a winding number that tells if the ray is inside, so that overlapping shells
+				// are filled. If rounding errors break the sum of the crossings, the parity of the crossings is used
+				const auto oriented = (winding == 0);
+
+				// Voxels whose center is inside are between a crossing and the next one
+				for (std::size_t c = 0; c + 1 < crossings.size(); c++)
 				{
-					const auto vertex = u * vertex1 + v * vertex2 + (1.0f - u - v) * vertex3;
-					// Find nearest voxel center and add it to the grid
-					const auto voxel = grid.voxelFromPoint(vertex);
+					winding += crossings[c].second;
+
+					const auto inside = oriented ? (winding != 0) : (c % 2 == 0);
 
-					if (grid.isVoxelInsideGrid(voxel))
+					if (inside)
 					{
-						grid.add(voxel.x, voxel.y, voxel.z);
+						const auto startZ = std::max(int(std::ceil(crossings[c].first)), 0);
+						const auto endZ = std::min(int(std::floor(crossings[c + 1].first)), grid.resolutionZ() - 1);
+
+						for (int z = startZ; z <= endZ; z++)
+						{
+							column[z >> 6] |= std::uint64_t(1) << (z & 63);
+						}
 					}
 				}
 			}
 		}
 	}
+
+	addBrickWords(grid, brickWords);
 }
 
 void fillCavitiesInGrid(VoxelGrid& grid)
 {
-	// Complete volumes with Union-Find
-	// Warning: requires a lot of memory for big grids
-	const auto nbVoxels = grid.resolutionX() * grid.resolutionY() * grid.resolutionZ();
+	const auto wordsPerColumn = grid.wordsPerColumn();
+	const auto numberColumns = std::size_t(grid.resolutionX()) * std::size_t(grid.resolutionY());
 
-	UnionFind unionFind(nbVoxels);
+	// Empty voxels of the grid, and empty voxels reached from the border of the grid
+	std::vector<std::uint64_t> empty(numberColumns * wordsPerColumn);
+	std::vector<std::uint64_t> exterior(numberColumns * wordsPerColumn, 0);
 
-	std::array<std::tuple<int, int, int>, 3> directions =
-	{ {
-		{1, 0, 0},
-		{0, 1, 0},
-		{0, 0, 1}
-	} };
+	const auto columnIndex = [&grid, wordsPerColumn](int x, int y) {
+		return (std::size_t(x) * grid.resolutionY() + y) * wordsPerColumn;
+	};
 
+	// Start from the empty voxels on the border of the grid
+	#pragma omp parallel for
 	for (int x = 0; x < grid.resolutionX(); x++)
 	{
 		for (int y = 0; y < grid.resolutionY(); y++)
 		{
-			for (int z = 0; z < grid.resolutionZ(); z++)
+			const auto column = columnIndex(x, y);
+			const auto borderColumn = (x == 0 || y == 0 || x == grid.resolutionX() - 1 || y == grid.resolutionY() - 1);
+
+			for (int w = 0; w < wordsPerColumn; w++)
 			{
-				// Check that neighbors are of the same type
-				// Check that neighbors are of the same type
-				for (const auto& direction : directions)
-				{
-					const auto vx = clamp(x + std::get<0>(direction), 0, grid.resolutionX() - 1);
-					const auto vy = clamp(y + std::get<1>(direction), 0, grid.resolutionY() - 1);
-					const auto vz = clamp(z + std::get<2>(direction), 0, grid.resolutionZ() - 1);
+				// Bits after the end of the column are not empty voxels
+				empty[column + w] = ~grid.word(w, x, y) & rangeMask(0, std::min(grid.resolutionZ() - 64 * w, 64));
+			}
 
-					if ((vx != x || vy != y || vz != z) && (grid.hasVoxel(x, y, z) == grid.hasVoxel(vx, vy, vz)))
-					{
-						// The voxel (x, y, z) has the same type as its neighbor
-						// Find the index of the voxel in the union find list
-						const auto firstIndex = grid.voxelIndex(x, y, z);
-						const auto secondIndex = grid.voxelIndex(vx, vy, vz);
+			if (borderColumn)
+			{
+				std::copy(&empty[column], &empty[column] + wordsPerColumn, &exterior[column]);
+			}
+			else
+			{
+				exterior[column] = empty[column] & 1;
+				exterior[column + wordsPerColumn - 1] |= empty[column + wordsPerColumn - 1] & (std::uint64_t(1) << ((grid.resolutionZ() - 1) & 63));
 
-						// Union between (x, y, z) and (vx, vy, vz)
-						unionFind.unionNodes(firstIndex, secondIndex);
-					}
-				}
+				fillColumnRuns(&exterior[column], &empty[column], wordsPerColumn);
 			}
 		}
 	}
 
-	// List all non empty subsets indexed by root node
-	std::vector<unsigned int> connectedComponentsRoots;
-	for (unsigned int i = 0; i < nbVoxels; i++)
-	{
-		if (unionFind.findNode(i) == i)
+	// Extend the exterior from a neighbor column, and along the Z axis in the column
+	const auto extendExterior = [&](int x, int y, int fromX, int fromY) {
+		const auto column = columnIndex(x, y);
+		const auto fromColumn = columnIndex(fromX, fromY);
+
+		bool reached = false;
+		for (int w = 0; w < wordsPerColumn; w++)
 		{
-			connectedComponentsRoots.push_back(i);
-		}
-	}
-	std::sort(connectedComponentsRoots.begin(), connectedComponentsRoots.end());
+			const auto bits = exterior[fromColumn + w] & empty[column + w] & ~exterior[column + w];
 
-	// A vector with all connected components
-	std::vector<std::vector<int>> connectedComponents;
-	connectedComponents.reserve(connectedComponentsRoots.size());
+			if (bits != 0)
+			{
+				exterior[column + w] |= bits;
+				reached = true;
+			}
+		}
 
-	// Add the roots to the connected components
-	for (const auto root : connectedComponentsRoots)
-	{
-		connectedComponents.emplace_back(1, root);
-	}
+		if (reached)
+		{
+			fillColumnRuns(&exterior[column], &empty[column], wordsPerColumn);
+		}
 
-	qInfo() << "Total number of connected components: " << connectedComponents.size();
+		return reached;
+	};
 
-	// Add every voxels to their connected components
-	for (unsigned int i = 0; i < nbVoxels; i++)
+	// Sweep the grid along the Y axis and then along the X axis, until the exterior stops growing
+	int numberSweeps = 0;
+	int changedColumns = 0;
+	do
 	{
-		const auto root = unionFind.findNode(i);
+		changedColumns = 0;
 
-		// If the node is not a root
-		if (root != i)
+		// Each X slice is swept by one thread
+		#pragma omp parallel for reduction(+:changedColumns)
+		for (int x = 0; x < grid.resolutionX(); x++)
 		{
-			// Search for his connected component
-			const auto it = std::lower_bound(connectedComponentsRoots.begin(), connectedComponentsRoots.end(), root);
+			for (int y = 1; y < grid.resolutionY(); y++)
+			{
+				changedColumns += extendExterior(x, y, x, y - 1);
+			}
 
-			if (it != connectedComponentsRoots.end())
+			for (int y = grid.resolutionY() - 2; y >= 0; y--)
 			{
-				const int connectedComp = std::distance(connectedComponentsRoots.begin(), it);
-				connectedComponents[connectedComp].push_back(i);
+				changedColumns += extendExterior(x, y, x, y + 1);
 			}
 		}
-	}
-
-	// Find the second major empty connected component
-	int majorEmptyComponent = -1;
-	for (int i = 0; i < connectedComponents.size(); i++)
-	{
-		const auto firstVoxel = grid.voxelFromIndex(connectedComponents[i].front());
 
-		// Check if this connected component is empty in the voxel grid
-		if (!grid.hasVoxel(firstVoxel))
+		// Each Y row is swept by one thread
+		#pragma omp parallel for reduction(+:changedColumns)
+		for (int y = 0; y < grid.resolutionY(); y++)
 		{
-			qInfo() << "Empty component " << i << " " << connectedComponents[i].size() << " voxels";
+			for (int x = 1; x < grid.resolutionX(); x++)
+			{
+				changedColumns += extendExterior(x, y, x - 1, y);
+			}
 
-			// If no major empty component has been found yet
-			// Or the current major component is smaller than the component in review
-			if (majorEmptyComponent == -1
-				|| (connectedComponents[i].size() > connectedComponents[majorEmptyComponent].size()))
+			for (int x = grid.resolutionX() - 2; x >= 0; x--)
 			{
-				majorEmptyComponent = i;
+				changedColumns += extendExterior(x, y, x + 1, y);
 			}
 		}
+
+		numberSweeps++;
 	}
+	while (changedColumns > 0);
 
-	// Fill all empty connected components that are not the biggest
-	for (int i = 0; i < connectedComponents.size(); i++)
+	// Fill the empty voxels that are not reached from the border
+	long long numberFilledVoxels = 0;
+	for (int x = 0; x < grid.resolutionX(); x++)
 	{
-		if (i != majorEmptyComponent)
+		for (int y = 0; y < grid.resolutionY(); y++)
 		{
-			const auto firstVoxel = grid.voxelFromIndex(connectedComponents[i].front());
+			const auto column = columnIndex(x, y);
 
-			// Check if this connected component is empty in the voxel grid
-			if (!grid.hasVoxel(firstVoxel))
+			for (int w = 0; w < wordsPerColumn; w++)
 			{
+				const auto cavities = empty[column + w] & ~exterior[column + w];
 
-				// Fill all voxels of this connected component
-				for (const auto index : connectedComponents[i])
+				if (cavities != 0)
 				{
-					const auto v = grid.voxelFromIndex(index);
-					grid.add(v.x, v.y, v.z);
+					grid.setWord(w, x, y, grid.word(w, x, y) | cavities);
+					numberFilledVoxels += countBits(cavities);
 				}
 			}
 		}
 	}
+
+	qInfo() << "Number of voxels filled in cavities: " << numberFilledVoxels << " after " << numberSweeps << " sweeps";
 }
 
 PrecisionRecall computePrecisionRecall(const VoxelGrid& grid, const VoxelGrid& reference)
@@ -923,6 +2124,33 @@ PrecisionRecall computePrecisionRecall(const VoxelGrid& grid, const VoxelGrid& r
 	// Voxels present in the reference grid but not in the predicted grid
 	long long falseNegatives = 0;
 
+	if (grid.resolutionX() == reference.resolutionX()
+	 && grid.resolutionY() == reference.resolutionY()
+	 && grid.resolutionZ() == reference.resolutionZ())
+	{
+		// Compare the grids word by word
+		for (int x = 0; x < grid.resolutionX(); x++)
+		{
+			for (int y = 0; y < grid.resolutionY(); y++)
+			{
+				for (int w = 0; w < grid.wordsPerColumn(); w++)
+				{
+					const auto predicted = grid.word(w, x, y);
+					const auto truth = reference.word(w, x, y);
+
+					truePositives += countBits(predicted & truth);
+					falsePositives += countBits(predicted & ~truth);
+					falseNegatives += countBits(~predicted & truth);
+				}
+			}
+		}
+
+		const float precision = float(truePositives) / (truePositives + falsePositives);
+		const float recall = float(truePositives) / (truePositives + falseNegatives);
+
+		return { precision, recall };
+	}
+
 	// Compute true positives and false positives
 	for (const auto& v : grid.voxels())
 	{
@@ -987,23 +2215,27 @@ float boundingCylinderVolume(const VoxelGrid& grid)
 
 float computeDirectionality(const VoxelGrid& grid)
 {
-	std::vector<bool> shadow(grid.resolutionX() * grid.resolutionY(), false);
-
-	const auto& voxels = grid.voxels();
-	for (int i = 0; i < voxels.size(); i++)
+	// A column is in shade if any of its words is not empty
+	long long shadowTotal = 0;
+	for (int x = 0; x < grid.resolutionX(); x++)
 	{
-		const auto voxel = voxels[i];
-		// Index of the Z projection in a 1D array
-		const auto index = voxel.y * grid.resolutionX() + voxel.x;
+		for (int y = 0; y < grid.resolutionY(); y++)
+		{
+			int w = 0;
+			while (w < grid.wordsPerColumn() && grid.word(w, x, y) == 0)
+			{
+				w++;
+			}
 
-		shadow[index] = true;
+			if (w < grid.wordsPerColumn())
+			{
+				shadowTotal++;
+			}
+		}
 	}
 
-	// Count number of true in the shadow grid
-	const auto shadowTotal = std::count(shadow.begin(), shadow.end(), true);
-
 	// Return the proportion of shadow on the floor of the voxel grid
-	return float(shadowTotal) / float(shadow.size());
+	return float(shadowTotal) / float(grid.resolutionX() * grid.resolutionY());
 }
 
 float computeHeight(const VoxelGrid& grid)
@@ -1045,15 +2277,49 @@ void renderGridAndSave(
 
 float maximumNearestDistanceFromGridToGrid(const VoxelGrid& grid, const VoxelGrid& reference)
 {
-	float maximumNearestDistance = 0.0f;
-	
-	for (int i = 0; i < grid.voxels().size(); i++)
+	std::vector<float> distances;
+
+	if (DistanceTransform::haveSameLayout(grid, reference))
+	{
+		const DistanceTransform transform(reference, grid);
+		distances = transform.distances(grid);
+	}
+	else
 	{
-		const auto query = grid.voxel(grid.voxels()[i]);
-		const auto nearestVoxel = reference.nearestVoxel(query);
-		const auto dist = query.distanceToPoint(nearestVoxel);
+		// Voxels of the grids are not at the same positions, nearest voxels are found in the KD-tree of the reference
+		const auto& voxels = grid.voxels();
+		const auto& tree = reference.kdTree();
+
+		std::vector<QVector3D> queries(voxels.size());
+
+		#pragma omp parallel for
+		for (int i = 0; i < int(voxels.size()); i++)
+		{
+			queries[i] = grid.voxel(voxels[i]);
+		}
+
+		const auto nearestVoxels = tree.nearest(queries);
+
+		distances.resize(queries.size());
+
+		#pragma omp parallel for
+		for (int i = 0; i < int(queries.size()); i++)
+		{
+			distances[i] = (nearestVoxels[i] >= 0)
+			             ? queries[i].distanceToPoint(tree.point(nearestVoxels[i]))
+			             : std::numeric_limits<float>::infinity();
+		}
+	}
+
+	float maximumNearestDistance = 0.0f;
 
-		maximumNearestDistance = std::max(maximumNearestDistance, dist);
+	for (const auto dist : distances)
+	{
+		// Without reference voxels, distances are infinite
+		if (dist != std::numeric_limits<float>::infinity())
+		{
+			maximumNearestDistance = std::max(maximumNearestDistance, dist);
+		}
 	}
 
 	return maximumNearestDistance;
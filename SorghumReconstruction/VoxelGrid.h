@@ -1,5 +1,11 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include <QVector3D>
 #include <QDir>
 
@@ -57,10 +63,35 @@ struct Voxel
 	}
 };
 
+/**
+ * \brief How the occupancy of a voxel grid is stored
+ */
+enum class VoxelStorage
+{
+	Dense, // One bit per voxel of the grid, fastest when the grid fits in memory
+	Sparse // Bricks of 8x8x8 bits only allocated where voxels are added, memory grows with the object
+	       // Bricks are found through pages of 8x8x8 bricks, also only allocated where voxels are added
+};
+
+class VoxelKdTree;
+
 class VoxelGrid
 {
 public:
-	VoxelGrid(const AABB& boundingBox, int resolutionX, int resolutionY, int resolutionZ);
+	VoxelGrid(const AABB& boundingBox,
+	          int resolutionX,
+	          int resolutionY,
+	          int resolutionZ,
+	          VoxelStorage storage = VoxelStorage::Dense);
+
+	/**
+	 * \brief Copy a voxel grid, its list of voxels is only copied if it is up to date
+	 */
+	VoxelGrid(const VoxelGrid& other);
+	VoxelGrid(VoxelGrid&& other);
+
+	VoxelGrid& operator=(const VoxelGrid& other);
+	VoxelGrid& operator=(VoxelGrid&& other);
 
 	/**
 	 * \brief Return the bounding box of the voxel grid
@@ -86,6 +117,12 @@ public:
 	 */
 	int resolutionZ() const;
 
+	/**
+	 * \brief Return how the occupancy of the voxel grid is stored
+	 * \return The storage of the voxel grid
+	 */
+	VoxelStorage storage() const;
+
 	/**
 	 * \brief Return the size of a voxel on the X axis
 	 * \return The size of a voxel on the X axis
@@ -111,10 +148,17 @@ public:
 
 	/**
 	 * \brief Return the list of voxels after space has been carved
-	 * \return The list of voxels after space has been carved
+	 *        The list is generated from the bits of the grid on the first call after a modification
+	 * \return The list of voxels, sorted in increasing order
 	 */
 	const std::vector<Voxel>& voxels() const;
 
+	/**
+	 * \brief Return the number of voxels in the grid, without generating the list of voxels
+	 * \return The number of voxels in the grid
+	 */
+	std::size_t numberVoxels() const;
+
 	/**
 	 * \brief Return true if the voxel grid is empty (no voxels)
 	 * \return True if the voxel grid is empty
@@ -123,13 +167,16 @@ public:
 
 	/**
 	 * \brief Sort the list of voxels
+	 * \deprecated The list is always generated in increasing order and voxels() can be called from several threads,
+	 *             this only generates the list if needed, call voxels() instead
 	 */
+	[[deprecated("The list of voxels is always sorted, call voxels() instead")]]
 	void sortVoxels();
 
 	/**
 	 * \brief Give the index of a voxel in the list
 	 *        Must be called with a voxel that is in the list, return -1 otherwise
-	 *        Must be sorted to return valid results!
+	 *        With dense storage, the index is the number of bits before the voxel, found in constant time
 	 * \param x Integer coordinate on the X axis
 	 * \param y Integer coordinate on the Y axis
 	 * \param z Integer coordinate on the Z axis
@@ -161,6 +208,66 @@ public:
 	 */
 	void add(int x, int y, int z);
 
+	/**
+	 * \brief Add all voxels of a column between two coordinates on the Z axis
+	 * \param x Integer coordinate on the X axis
+	 * \param y Integer coordinate on the Y axis
+	 * \param startZ First coordinate on the Z axis
+	 * \param endZ Coordinate after the last one on the Z axis
+	 */
+	void addRange(int x, int y, int startZ, int endZ);
+
+	/**
+	 * \brief Remove all voxels of a column between two coordinates on the Z axis
+	 * \param x Integer coordinate on the X axis
+	 * \param y Integer coordinate on the Y axis
+	 * \param startZ First coordinate on the Z axis
+	 * \param endZ Coordinate after the last one on the Z axis
+	 */
+	void removeRange(int x, int y, int startZ, int endZ);
+
+	/**
+	 * \brief Return the number of 64-bit words in a column along the Z axis
+	 * \return The number of words in a column
+	 */
+	int wordsPerColumn() const
+	{
+		return m_wordsPerColumn;
+	}
+
+	/**
+	 * \brief Return 64 consecutive voxels of a column, voxel z is the bit (z & 63) of the word (z >> 6)
+	 * \param index The index of the word in the column
+	 * \param x Integer coordinate on the X axis
+	 * \param y Integer coordinate on the Y axis
+	 * \return The bits of the voxels, bits after the end of the column are zeros
+	 */
+	std::uint64_t word(int index, int x, int y) const
+	{
+		if (m_storage == VoxelStorage::Sparse)
+		{
+			return sparseWord(index, x, y);
+		}
+
+		return m_bits[(std::size_t(x) * m_resolutionY + y) * m_wordsPerColumn + index];
+	}
+
+	/**
+	 * \brief Replace 64 consecutive voxels of a column
+	 * \param index The index of the word in the column
+	 * \param x Integer coordinate on the X axis
+	 * \param y Integer coordinate on the Y axis
+	 * \param bits The bits of the voxels, bits after the end of the column are ignored
+	 */
+	void setWord(int index, int x, int y, std::uint64_t bits);
+
+	/**
+	 * \brief Replace all voxels in the grid
+	 *        Faster than adding voxels one by one and sorting them
+	 * \param voxels Voxels sorted in increasing order, without duplicates
+	 */
+	void setVoxels(std::vector<Voxel> voxels);
+
 	/**
 	 * \brief Return true if the voxel exists in the grid
 	 * \param x Integer coordinate on the X axis
@@ -223,6 +330,12 @@ public:
 	 */
 	bool isVoxelInsideGrid(const Voxel& voxel) const;
 
+	/**
+	 * \brief Return the KD-tree of the voxels, built when first requested
+	 * \return The KD-tree, whose points are numbered in the order of voxels()
+	 */
+	const VoxelKdTree& kdTree() const;
+
 	/**
 	 * \brief Return the nearest voxel from a query point
 	 * \param query A query point
@@ -324,14 +437,131 @@ private:
 	int m_resolutionZ;
 
 	/**
-	 * \brief A vector containing the flat 3D voxel grid
+	 * \brief 8x8x8 voxels, the word x holds 8 columns of 8 bits along Z, ordered by y
+	 */
+	using Brick = std::array<std::uint64_t, 8>;
+
+	/**
+	 * \brief Indices of 8x8x8 bricks in the list of bricks, -1 if the brick is empty, ordered by X, Y and then Z
+	 */
+	using BrickPage = std::array<int, 512>;
+
+	/**
+	 * \brief Return the index of a brick in the list of bricks, -1 if the brick is empty
+	 */
+	int brickIndex(int brickX, int brickY, int brickZ) const;
+
+	/**
+	 * \brief Return the index of a brick in the list of bricks, allocating the brick and its page if needed
+	 */
+	int allocateBrick(int brickX, int brickY, int brickZ);
+
+	/**
+	 * \brief Return 64 consecutive voxels of a column from the 8 bricks covering them
+	 */
+	std::uint64_t sparseWord(int index, int x, int y) const;
+
+	/**
+	 * \brief Replace 64 consecutive voxels of a column, in both storages
 	 */
-	std::vector<Voxel> m_voxels;
+	void writeWord(int index, int x, int y, std::uint64_t bits);
 
 	/**
-	 * \brief The voxel grid
+	 * \brief Generate the list of voxels from the bits if it is not up to date
 	 */
-	std::vector<bool> m_grid;
+	void updateVoxels() const;
+
+	/**
+	 * \brief Count the voxels before each block of words, with dense storage
+	 */
+	void updateBlockRanks() const;
+
+	/**
+	 * \brief Mark the list of voxels as outdated and release its memory
+	 */
+	void invalidateVoxels();
+
+	/**
+	 * \brief How the occupancy of the voxel grid is stored
+	 */
+	VoxelStorage m_storage;
+
+	/**
+	 * \brief Number of 64-bit words in a column along the Z axis
+	 */
+	int m_wordsPerColumn;
+
+	/**
+	 * \brief Bits of the voxel grid, column by column along the Z axis, with dense storage
+	 */
+	std::vector<std::uint64_t> m_bits;
+
+	/**
+	 * \brief Number of bricks on the X axis, with sparse storage
+	 */
+	int m_bricksX;
+
+	/**
+	 * \brief Number of bricks on the Y axis, with sparse storage
+	 */
+	int m_bricksY;
+
+	/**
+	 * \brief Number of bricks on the Z axis, with sparse storage
+	 */
+	int m_bricksZ;
+
+	/**
+	 * \brief The allocated bricks, with sparse storage
+	 */
+	std::vector<Brick> m_bricks;
+
+	/**
+	 * \brief Number of pages of the brick directory on the X axis, with sparse storage
+	 */
+	int m_pagesX;
+
+	/**
+	 * \brief Number of pages of the brick directory on the Y axis, with sparse storage
+	 */
+	int m_pagesY;
+
+	/**
+	 * \brief Number of pages of the brick directory on the Z axis, with sparse storage
+	 */
+	int m_pagesZ;
+
+	/**
+	 * \brief Index of each page of the brick directory in the list of pages, -1 if all its bricks are empty
+	 *        A page covers 8x8x8 bricks, pages are ordered by X, Y and then Z
+	 */
+	std::vector<int> m_pageIndices;
+
+	/**
+	 * \brief The allocated pages of the brick directory, with sparse storage
+	 */
+	std::vector<BrickPage> m_pages;
+
+	/**
+	 * \brief The list of voxels, generated from the bits when requested
+	 */
+	mutable std::vector<Voxel> m_voxels;
+
+	/**
+	 * \brief True if the list of voxels matches the bits, set with release semantics once the list is complete
+	 */
+	mutable std::atomic<bool> m_voxelsValid;
+
+	/**
+	 * \brief Number of voxels before each block of 8 words of bits, built with the list of voxels
+	 */
+	mutable std::vector<std::uint32_t> m_blockRanks;
+
+	/**
+	 * \brief KD-tree of the list of voxels, built when requested and shared by the copies of the grid
+	 *        Const methods only access it with std::atomic_load and std::atomic_store
+	 */
+	mutable std::shared_ptr<const VoxelKdTree> m_kdTree;
 };
 
 /**
@@ -355,24 +585,40 @@ void drawCubeInGrid(VoxelGrid& grid,
 long long countNumberSurfaceVoxels(const VoxelGrid& grid);
 
 /**
- * \brief Apply a 3D dilation morphology operation on a voxel grid
+ * \brief Shape of the structuring element of morphology operations, inside a cube of the size of the kernel
+ */
+enum class StructuringElement
+{
+	Cube,  // All voxels of the kernel, applied as three 1D operations along the axes
+	Cross, // Voxels on the three axes going through the center of the kernel
+	Sphere // Voxels in the ball inscribed in the kernel
+};
+
+/**
+ * \brief Apply a 3D dilation morphology operation on a voxel grid.
+ *        The grid is processed 64 voxels at a time with shifted words of bits
  * \param grid The initial voxel grid
  * \param kernelSize Size of the kernel for dilation
+ * \param element Shape of the structuring element
  * \return A dilated version of the initial voxel grid
  */
-VoxelGrid morphingDilation(const VoxelGrid& grid, int kernelSize);
+VoxelGrid morphingDilation(const VoxelGrid& grid, int kernelSize, StructuringElement element = StructuringElement::Cube);
 
 /**
- * \brief Apply a 3D erosion morphology operation on a voxel grid
+ * \brief Apply a 3D erosion morphology operation on a voxel grid.
+ *        The grid is processed 64 voxels at a time with shifted words of bits, voxels outside of the grid are empty
  * \param grid The initial voxel grid
  * \param kernelSize Size of the kernel for dilation
+ * \param element Shape of the structuring element
  * \return An eroded version of the initial voxel grid
  */
-VoxelGrid morphingErosion(const VoxelGrid& grid, int kernelSize);
+VoxelGrid morphingErosion(const VoxelGrid& grid, int kernelSize, StructuringElement element = StructuringElement::Cube);
 
 /**
  * \brief Add voxels where the mesh intersects the voxel grid
+ *        Every voxel whose box intersects a triangle is added, triangles are voxelized in parallel on bricks of columns
  * \param grid An existing voxel grid, in which voxels will be added
+ * \param worldMatrix Transformation of the vertices of the mesh
  * \param vertices Vertices of the mesh
  * \param faces Triangles of the mesh
  */
@@ -381,10 +627,27 @@ void voxelizeMesh(VoxelGrid& grid,
 	              const std::vector<QVector3D>& vertices,
 	              const std::vector<std::tuple<int, int, int>>& faces);
 
+/**
+ * \brief Add the voxels of the surface and of the inside of a mesh
+ *        If the mesh is made of closed shells facing outward (every edge shared by exactly two faces in opposite
+ *        directions, and a positive volume enclosed by each shell), rays along the Z axis are cast through the columns
+ *        in parallel and the winding number of the crossings of a ray gives the voxels inside.
+ *        Columns crossing the mesh an odd number of times only keep the voxels of the surface
+ *        Otherwise, such as for open or inward-facing shells, the cavities of the grid are filled with fillCavitiesInGrid
+ * \param grid An existing voxel grid, in which voxels will be added
+ * \param worldMatrix Transformation of the vertices of the mesh
+ * \param vertices Vertices of the mesh
+ * \param faces Triangles of the mesh
+ */
+void voxelizeSolidMesh(VoxelGrid& grid,
+                       const QMatrix4x4& worldMatrix,
+                       const std::vector<QVector3D>& vertices,
+                       const std::vector<std::tuple<int, int, int>>& faces);
+
 /**
  * \brief Fill cavities in a voxel grid
- *        Search for connected components
- *        Fill all empty connected components, except the biggest one
+ *        Empty voxels 6-connected to the border of the grid are flood-filled with sweeps over words of bits
+ *        Fill all empty voxels that are not reached from the border
  * \param grid A voxel grid to fill
  */
 void fillCavitiesInGrid(VoxelGrid& grid);
@@ -440,7 +703,8 @@ void renderGridAndSave(const VoxelGrid& grid,
 /**
  * \brief For each voxel in grid, find the nearest voxel in the reference.
  *        This function returns the maximum of such a distance.
- *        Brute force algorithm
+ *        If both grids have the same resolutions and bounding box, distances come from the exact distance transform
+ *        of the reference, computed in parallel. Otherwise they are found with the KD-tree of the reference
  * \param grid A voxel grid from which we compute the distance to the reference grid
  * \param reference A reference voxel grid
  * \return The maximum distance from any voxel in the grid to the nearest voxel in the reference
@@ -0,0 +1,167 @@
+#include "VoxelKdTree.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	/**
+	 * \brief Maximum number of points in a leaf of the KD-tree
+	 */
+	constexpr std::size_t leafSize = 16;
+
+	/**
+	 * \brief Result of a nearest neighbor search, keeping the first point among points at the same distance
+	 */
+	class NearestResultSet
+	{
+	public:
+		NearestResultSet() :
+			m_index(std::numeric_limits<std::size_t>::max()),
+			m_distance(std::numeric_limits<float>::max())
+		{
+		}
+
+		bool full() const
+		{
+			return true;
+		}
+
+		std::size_t size() const
+		{
+			return (m_index == std::numeric_limits<std::size_t>::max()) ? 0 : 1;
+		}
+
+		bool addPoint(float distance, std::size_t index)
+		{
+			if (distance < m_distance || (distance == m_distance && index < m_index))
+			{
+				m_distance = distance;
+				m_index = index;
+			}
+
+			return true;
+		}
+
+		float worstDist() const
+		{
+			// nanoflann only adds points strictly closer than this distance, points at the same distance are wanted too
+			return std::nextafter(m_distance, std::numeric_limits<float>::infinity());
+		}
+
+		int index() const
+		{
+			return (size() == 0) ? -1 : int(m_index);
+		}
+
+	private:
+		std::size_t m_index;
+		float m_distance;
+	};
+}
+
+VoxelKdTree::VoxelKdTree(const VoxelGrid& grid, const std::vector<Voxel>& voxels) :
+	m_points(voxels.size())
+{
+	#pragma omp parallel for
+	for (int i = 0; i < int(voxels.size()); i++)
+	{
+		m_points[i] = grid.voxel(voxels[i]);
+	}
+
+	m_index.reset(new Index(3, *this, nanoflann::KDTreeSingleIndexAdaptorParams(leafSize)));
+	m_index->buildIndex();
+}
+
+int VoxelKdTree::size() const
+{
+	return int(m_points.size());
+}
+
+const QVector3D& VoxelKdTree::point(int index) const
+{
+	assert(index >= 0 && index < int(m_points.size()));
+
+	return m_points[index];
+}
+
+int VoxelKdTree::nearest(const QVector3D& query) const
+{
+	if (m_points.empty())
+	{
+		return -1;
+	}
+
+	const float point[3] = { query.x(), query.y(), query.z() };
+
+	NearestResultSet result;
+	m_index->findNeighbors(result, point, nanoflann::SearchParams());
+
+	return result.index();
+}
+
+std::vector<int> VoxelKdTree::nearest(const std::vector<QVector3D>& queries) const
+{
+	std::vector<int> indices(queries.size(), -1);
+
+	#pragma omp parallel for
+	for (int i = 0; i < int(queries.size()); i++)
+	{
+		indices[i] = nearest(queries[i]);
+	}
+
+	return indices;
+}
+
+std::vector<int> VoxelKdTree::nearestNeighbors(const QVector3D& query, int numberNeighbors) const
+{
+	if (m_points.empty() || numberNeighbors <= 0)
+	{
+		return {};
+	}
+
+	const float point[3] = { query.x(), query.y(), query.z() };
+
+	std::vector<std::size_t> indices(std::min(std::size_t(numberNeighbors), m_points.size()));
+	std::vector<float> distances(indices.size());
+
+	const auto numberFound = m_index->knnSearch(point, indices.size(), indices.data(), distances.data());
+
+	return std::vector<int>(indices.begin(), indices.begin() + numberFound);
+}
+
+std::vector<int> VoxelKdTree::neighborsInRadius(const QVector3D& query, float radius) const
+{
+	if (m_points.empty())
+	{
+		return {};
+	}
+
+	const float point[3] = { query.x(), query.y(), query.z() };
+
+	// nanoflann compares squared distances
+	std::vector<std::pair<std::size_t, float>> matches;
+	m_index->radiusSearch(point, radius * radius, matches, nanoflann::SearchParams());
+
+	std::vector<int> indices;
+	indices.reserve(matches.size());
+
+	for (const auto& match : matches)
+	{
+		indices.push_back(int(match.first));
+	}
+
+	return indices;
+}
+
+std::size_t VoxelKdTree::kdtree_get_point_count() const
+{
+	return m_points.size();
+}
+
+float VoxelKdTree::kdtree_get_pt(std::size_t index, std::size_t dimension) const
+{
+	return m_points[index][int(dimension)];
+}
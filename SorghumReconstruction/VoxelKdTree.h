@@ -0,0 +1,103 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <QVector3D>
+
+#include <nanoflann/nanoflann.hpp>
+
+#include "VoxelGrid.h"
+
+/**
+ * \brief KD-tree of the centers of a list of voxels, to find the nearest voxels of query points
+ *        Points are numbered in the order of the list, among voxels at the same distance the first one is returned
+ */
+class VoxelKdTree
+{
+public:
+	/**
+	 * \brief Build the KD-tree of a list of voxels
+	 * \param grid The voxel grid giving the coordinates of the voxels
+	 * \param voxels A list of voxels
+	 */
+	VoxelKdTree(const VoxelGrid& grid, const std::vector<Voxel>& voxels);
+
+	VoxelKdTree(const VoxelKdTree&) = delete;
+	VoxelKdTree& operator=(const VoxelKdTree&) = delete;
+
+	/**
+	 * \brief Return the number of points in the tree
+	 * \return The number of points in the tree
+	 */
+	int size() const;
+
+	/**
+	 * \brief Return a point of the tree
+	 * \param index Index of the voxel in the list
+	 * \return The 3D coordinates of the voxel's center
+	 */
+	const QVector3D& point(int index) const;
+
+	/**
+	 * \brief Return the nearest voxel from a query point
+	 * \param query A query point
+	 * \return Index of the nearest voxel, -1 if the tree is empty
+	 */
+	int nearest(const QVector3D& query) const;
+
+	/**
+	 * \brief Return the nearest voxel from each query point, queries are processed in parallel
+	 * \param queries A list of query points
+	 * \return Index of the nearest voxel of each query, -1 if the tree is empty
+	 */
+	std::vector<int> nearest(const std::vector<QVector3D>& queries) const;
+
+	/**
+	 * \brief Return the k nearest voxels from a query point
+	 * \param query A query point
+	 * \param numberNeighbors Maximum number of voxels to return
+	 * \return Indices of the nearest voxels, by increasing distance
+	 */
+	std::vector<int> nearestNeighbors(const QVector3D& query, int numberNeighbors) const;
+
+	/**
+	 * \brief Return the voxels closer than a radius to a query point
+	 * \param query A query point
+	 * \param radius Radius of the search
+	 * \return Indices of the voxels in the radius, by increasing distance
+	 */
+	std::vector<int> neighborsInRadius(const QVector3D& query, float radius) const;
+
+	/**
+	 * \brief Number of points, required by nanoflann
+	 */
+	std::size_t kdtree_get_point_count() const;
+
+	/**
+	 * \brief Coordinate of a point, required by nanoflann
+	 */
+	float kdtree_get_pt(std::size_t index, std::size_t dimension) const;
+
+	/**
+	 * \brief Bounding box of the points, not provided so that nanoflann computes it
+	 */
+	template<typename BBox>
+	bool kdtree_get_bbox(BBox&) const
+	{
+		return false;
+	}
+
+private:
+	using Index = nanoflann::KDTreeSingleIndexAdaptor<nanoflann::L2_Simple_Adaptor<float, VoxelKdTree>, VoxelKdTree, 3, std::size_t>;
+
+	/**
+	 * \brief Centers of the voxels
+	 */
+	std::vector<QVector3D> m_points;
+
+	/**
+	 * \brief The KD-tree, referencing the points
+	 */
+	std::unique_ptr<Index> m_index;
+};
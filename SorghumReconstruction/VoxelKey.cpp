@@ -0,0 +1,252 @@
+#include "VoxelKey.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	/**
+	 * \brief Spread the 10 low bits of a value so that two bits are inserted between each bit
+	 */
+	std::uint32_t spreadBits(std::uint32_t value)
+	{
+		value &= 0x000003ff;
+		value = (value | (value << 16)) & 0x030000ff;
+		value = (value | (value << 8)) & 0x0300f00f;
+		value = (value | (value << 4)) & 0x030c30c3;
+		value = (value | (value << 2)) & 0x09249249;
+
+		return value;
+	}
+
+	/**
+	 * \brief Spread the 21 low bits of a value so that two bits are inserted between each bit
+	 */
+	std::uint64_t spreadBits(std::uint64_t value)
+	{
+		value &= 0x00000000001fffffull;
+		value = (value | (value << 32)) & 0x001f00000000ffffull;
+		value = (value | (value << 16)) & 0x001f0000ff0000ffull;
+		value = (value | (value << 8)) & 0x100f00f00f00f00full;
+		value = (value | (value << 4)) & 0x10c30c30c30c30c3ull;
+		value = (value | (value << 2)) & 0x1249249249249249ull;
+
+		return value;
+	}
+
+	/**
+	 * \brief Gather every third bit of a value, inverse of spreadBits
+	 */
+	std::uint32_t compactBits(std::uint32_t value)
+	{
+		value &= 0x09249249;
+		value = (value ^ (value >> 2)) & 0x030c30c3;
+		value = (value ^ (value >> 4)) & 0x0300f00f;
+		value = (value ^ (value >> 8)) & 0x030000ff;
+		value = (value ^ (value >> 16)) & 0x000003ff;
+
+		return value;
+	}
+
+	/**
+	 * \brief Gather every third bit of a value, inverse of spreadBits
+	 */
+	std::uint64_t compactBits(std::uint64_t value)
+	{
+		value &= 0x1249249249249249ull;
+		value = (value ^ (value >> 2)) & 0x10c30c30c30c30c3ull;
+		value = (value ^ (value >> 4)) & 0x100f00f00f00f00full;
+		value = (value ^ (value >> 8)) & 0x001f0000ff0000ffull;
+		value = (value ^ (value >> 16)) & 0x001f00000000ffffull;
+		value = (value ^ (value >> 32)) & 0x00000000001fffffull;
+
+		return value;
+	}
+
+	/**
+	 * \brief Pack a voxel in a key, lexicographic keys use the given number of bits per axis
+	 */
+	template<typename Key>
+	Key packVoxel(const Voxel& voxel, VoxelOrder order, int bitsPerAxis)
+	{
+		assert(voxel.x >= 0 && voxel.x < (1 << bitsPerAxis));
+		assert(voxel.y >= 0 && voxel.y < (1 << bitsPerAxis));
+		assert(voxel.z >= 0 && voxel.z < (1 << bitsPerAxis));
+
+		if (order == VoxelOrder::Morton)
+		{
+			return (spreadBits(Key(voxel.x)) << 2)
+			     | (spreadBits(Key(voxel.y)) << 1)
+			     | spreadBits(Key(voxel.z));
+		}
+
+		return (Key(voxel.x) << (2 * bitsPerAxis))
+		     | (Key(voxel.y) << bitsPerAxis)
+		     | Key(voxel.z);
+	}
+
+	/**
+	 * \brief Unpack a voxel from a key, lexicographic keys use the given number of bits per axis
+	 */
+	template<typename Key>
+	Voxel unpackVoxel(Key key, VoxelOrder order, int bitsPerAxis)
+	{
+		if (order == VoxelOrder::Morton)
+		{
+			return {
+				int(compactBits(Key(key >> 2))),
+				int(compactBits(Key(key >> 1))),
+				int(compactBits(key))
+			};
+		}
+
+		const auto mask = (Key(1) << bitsPerAxis) - 1;
+
+		return {
+			int((key >> (2 * bitsPerAxis)) & mask),
+			int((key >> bitsPerAxis) & mask),
+			int(key & mask)
+		};
+	}
+
+	/**
+	 * \brief Sort voxels with keys of the given type
+	 */
+	template<typename Key>
+	void sortVoxelsWithKeys(std::vector<Voxel>& voxels, VoxelOrder order, int bitsPerAxis)
+	{
+		const auto numberVoxels = int(voxels.size());
+
+		std::vector<Key> keys(numberVoxels);
+
+		#pragma omp parallel for
+		for (int i = 0; i < numberVoxels; i++)
+		{
+			keys[i] = packVoxel<Key>(voxels[i], order, bitsPerAxis);
+		}
+
+		// Only the bits used by the coordinates need to be sorted
+		radixSort(keys, 3 * bitsPerAxis);
+
+		#pragma omp parallel for
+		for (int i = 0; i < numberVoxels; i++)
+		{
+			voxels[i] = unpackVoxel<Key>(keys[i], order, bitsPerAxis);
+		}
+	}
+}
+
+template<typename Key>
+Key encodeVoxel(const Voxel& voxel, VoxelOrder order)
+{
+	return packVoxel<Key>(voxel, order, voxelKeyBitsPerAxis<Key>());
+}
+
+template<typename Key>
+Voxel decodeVoxel(Key key, VoxelOrder order)
+{
+	return unpackVoxel<Key>(key, order, voxelKeyBitsPerAxis<Key>());
+}
+
+template<typename Key>
+void radixSort(std::vector<Key>& keys, int numberBits)
+{
+	const int digitBits = 8;
+	const int numberDigits = 1 << digitBits;
+
+	// Keys are split in one chunk per thread, each chunk keeps its own histogram
+	const auto numberKeys = keys.size();
+	const int numberChunks = omp_get_max_threads();
+
+	std::vector<Key> sortedKeys(numberKeys);
+	std::vector<std::size_t> offsets(std::size_t(numberChunks) * numberDigits);
+
+	for (int shift = 0; shift < numberBits; shift += digitBits)
+	{
+		std::fill(offsets.begin(), offsets.end(), 0);
+
+		#pragma omp parallel
+		{
+			// The team may be smaller than the number of chunks
+			for (int chunk = omp_get_thread_num(); chunk < numberChunks; chunk += omp_get_num_threads())
+			{
+				const auto begin = numberKeys * chunk / numberChunks;
+				const auto end = numberKeys * (chunk + 1) / numberChunks;
+
+				auto histogram = offsets.data() + std::size_t(chunk) * numberDigits;
+				for (auto i = begin; i < end; i++)
+				{
+					histogram[(keys[i] >> shift) & (numberDigits - 1)]++;
+				}
+			}
+
+			#pragma omp barrier
+
+			// Start of each digit of each chunk in the sorted keys, chunks keep their order so the sort is stable
+			#pragma omp single
+			{
+				std::size_t offset = 0;
+				for (int digit = 0; digit < numberDigits; digit++)
+				{
+					for (int chunk = 0; chunk < numberChunks; chunk++)
+					{
+						auto& count = offsets[std::size_t(chunk) * numberDigits + digit];
+						const auto chunkCount = count;
+						count = offset;
+						offset += chunkCount;
+					}
+				}
+			}
+
+			for (int chunk = omp_get_thread_num(); chunk < numberChunks; chunk += omp_get_num_threads())
+			{
+				const auto begin = numberKeys * chunk / numberChunks;
+				const auto end = numberKeys * (chunk + 1) / numberChunks;
+
+				auto chunkOffsets = offsets.data() + std::size_t(chunk) * numberDigits;
+				for (auto i = begin; i < end; i++)
+				{
+					sortedKeys[chunkOffsets[(keys[i] >> shift) & (numberDigits - 1)]++] = keys[i];
+				}
+			}
+		}
+
+		keys.swap(sortedKeys);
+	}
+}
+
+void sortVoxels(std::vector<Voxel>& voxels, VoxelOrder order)
+{
+	int maximumCoordinate = 0;
+	for (const auto& voxel : voxels)
+	{
+		maximumCoordinate = std::max({ maximumCoordinate, voxel.x, voxel.y, voxel.z });
+	}
+
+	// Number of bits needed to store the coordinates
+	int bitsPerAxis = 1;
+	while ((maximumCoordinate >> bitsPerAxis) != 0)
+	{
+		bitsPerAxis++;
+	}
+
+	if (bitsPerAxis <= voxelKeyBitsPerAxis<std::uint32_t>())
+	{
+		sortVoxelsWithKeys<std::uint32_t>(voxels, order, bitsPerAxis);
+	}
+	else
+	{
+		assert(bitsPerAxis <= voxelKeyBitsPerAxis<std::uint64_t>());
+
+		sortVoxelsWithKeys<std::uint64_t>(voxels, order, bitsPerAxis);
+	}
+}
+
+template std::uint32_t encodeVoxel<std::uint32_t>(const Voxel& voxel, VoxelOrder order);
+template std::uint64_t encodeVoxel<std::uint64_t>(const Voxel& voxel, VoxelOrder order);
+template Voxel decodeVoxel<std::uint32_t>(std::uint32_t key, VoxelOrder order);
+template Voxel decodeVoxel<std::uint64_t>(std::uint64_t key, VoxelOrder order);
+template void radixSort<std::uint32_t>(std::vector<std::uint32_t>& keys, int numberBits);
+template void radixSort<std::uint64_t>(std::vector<std::uint64_t>& keys, int numberBits);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "VoxelGrid.h"
+
+/**
+ * \brief Order of voxels given by packed keys
+ */
+enum class VoxelOrder
+{
+	Lexicographic, // Order by X, Y and then Z, the same order as Voxel::operator<
+	Morton         // Z-order curve, voxels close in space are close in the list
+};
+
+/**
+ * \brief Return the number of bits used by the keys of each axis
+ *        32-bit keys store 10 bits per axis, 64-bit keys store 21 bits per axis
+ * \tparam Key std::uint32_t or std::uint64_t
+ * \return The number of bits per axis
+ */
+template<typename Key>
+constexpr int voxelKeyBitsPerAxis()
+{
+	return int(sizeof(Key) * 8) / 3;
+}
+
+/**
+ * \brief Pack the coordinates of a voxel in an integer
+ * \tparam Key std::uint32_t or std::uint64_t
+ * \param voxel A voxel whose coordinates fit on voxelKeyBitsPerAxis<Key>() bits
+ * \param order The order of the keys
+ * \return The key of the voxel
+ */
+template<typename Key>
+Key encodeVoxel(const Voxel& voxel, VoxelOrder order);
+
+/**
+ * \brief Unpack the coordinates of a voxel from an integer
+ * \tparam Key std::uint32_t or std::uint64_t
+ * \param key The key of a voxel
+ * \param order The order of the keys
+ * \return The voxel
+ */
+template<typename Key>
+Voxel decodeVoxel(Key key, VoxelOrder order);
+
+/**
+ * \brief Sort keys with a parallel least significant digit radix sort, 8 bits at a time
+ * \tparam Key std::uint32_t or std::uint64_t
+ * \param keys The keys to sort
+ * \param numberBits Number of low bits of the keys to sort, higher bits must be zero
+ */
+template<typename Key>
+void radixSort(std::vector<Key>& keys, int numberBits = int(sizeof(Key) * 8));
+
+/**
+ * \brief Sort voxels by packing them in keys, in linear time
+ *        32-bit keys are used if all coordinates are lower than 1024
+ * \param voxels The voxels to sort
+ * \param order The order of the sorted voxels
+ */
+void sortVoxels(std::vector<Voxel>& voxels, VoxelOrder order = VoxelOrder::Lexicographic);
@@ -0,0 +1,222 @@
+#include "VoxelNeighbors.h"
+
+#include <array>
+
+#include "MathUtils.h"
+
+namespace
+{
+	/**
+	 * \brief Bit-sliced counters of the 64 voxels of a word, the slice i holds the bit i of each counter
+	 *        Five slices are enough to count the 27 voxels of a 3x3x3 block
+	 */
+	using Counters = std::array<std::uint64_t, 5>;
+
+	/**
+	 * \brief A word of bits of a column of voxels
+	 */
+	struct ColumnWord
+	{
+		int index;
+		int y;
+		std::uint64_t bits;
+	};
+
+	/**
+	 * \brief Add 2^weight to the counters of the bits set in a word
+	 */
+	void addBits(Counters& counters, std::uint64_t bits, int weight)
+	{
+		for (int i = weight; i < int(counters.size()) && bits != 0; i++)
+		{
+			const auto carry = counters[i] & bits;
+			counters[i] ^= bits;
+			bits = carry;
+		}
+	}
+
+	/**
+	 * \brief Return the bits of the counters lower than a value
+	 */
+	std::uint64_t lessThan(const Counters& counters, int value)
+	{
+		if (value >= (1 << counters.size()))
+		{
+			return ~std::uint64_t(0);
+		}
+
+		std::uint64_t less = 0;
+		std::uint64_t equal = ~std::uint64_t(0);
+
+		// Compare from the most significant slice
+		for (int i = int(counters.size()) - 1; i >= 0; i--)
+		{
+			if ((value >> i) & 1)
+			{
+				less |= equal & ~counters[i];
+				equal &= counters[i];
+			}
+			else
+			{
+				equal &= ~counters[i];
+			}
+		}
+
+		return less;
+	}
+
+	/**
+	 * \brief Return the bits of the counters in the range [minimum; maximum]
+	 */
+	std::uint64_t inRange(const Counters& counters, int minimum, int maximum)
+	{
+		return lessThan(counters, maximum + 1) & ~lessThan(counters, minimum);
+	}
+
+	/**
+	 * \brief Count the voxels in the 3x3x3 block around each voxel of a word, the voxel included
+	 */
+	Counters countBlocks(const VoxelGrid& grid, int index, int x, int y)
+	{
+		Counters counters = {};
+
+		for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, grid.resolutionX() - 1); nx++)
+		{
+			for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, grid.resolutionY() - 1); ny++)
+			{
+				const auto current = grid.word(index, nx, ny);
+				const auto previous = (index > 0) ? grid.word(index - 1, nx, ny) : 0;
+				const auto next = (index + 1 < grid.wordsPerColumn()) ? grid.word(index + 1, nx, ny) : 0;
+
+				// Voxels at z - 1 and z + 1 shifted in front of the voxels at z
+				const auto below = (current << 1) | (previous >> 63);
+				const auto above = (current >> 1) | (next << 63);
+
+				// Full adder of the three voxels of the column
+				addBits(counters, below ^ current ^ above, 0);
+				addBits(counters, (below & current) | (above & (below ^ current)), 1);
+			}
+		}
+
+		return counters;
+	}
+
+	/**
+	 * \brief Call a function on each non-empty word of a grid with the counters of its voxels, in parallel on X slices
+	 * \param function Function (index, x, y, bits, counters), counters include the voxels themselves
+	 */
+	template<typename Function>
+	void forEachCounters(const VoxelGrid& grid, Function function)
+	{
+		#pragma omp parallel for
+		for (int x = 0; x < grid.resolutionX(); x++)
+		{
+			for (int y = 0; y < grid.resolutionY(); y++)
+			{
+				for (int w = 0; w < grid.wordsPerColumn(); w++)
+				{
+					const auto bits = grid.word(w, x, y);
+
+					if (bits != 0)
+					{
+						function(w, x, y, bits, countBlocks(grid, w, x, y));
+					}
+				}
+			}
+		}
+	}
+}
+
+VoxelGrid extractVoxelsByNeighbors(const VoxelGrid& grid, int minimumNeighbors, int maximumNeighbors)
+{
+	// Words of each X slice, written to the grid after the parallel loop
+	std::vector<std::vector<ColumnWord>> slices(grid.resolutionX());
+
+	forEachCounters(grid, [&](int index, int x, int y, std::uint64_t bits, const Counters& counters) {
+		// Counters include the voxel itself
+		const auto extracted = bits & inRange(counters, minimumNeighbors + 1, maximumNeighbors + 1);
+
+		if (extracted != 0)
+		{
+			slices[x].push_back({ index, y, extracted });
+		}
+	});
+
+	VoxelGrid result(grid.boundingBox(), grid.resolutionX(), grid.resolutionY(), grid.resolutionZ(), grid.storage());
+
+	for (int x = 0; x < grid.resolutionX(); x++)
+	{
+		for (const auto& word : slices[x])
+		{
+			result.setWord(word.index, x, word.y, word.bits);
+		}
+	}
+
+	return result;
+}
+
+VoxelGrid extractSurfaceVoxels(const VoxelGrid& grid)
+{
+	return extractVoxelsByNeighbors(grid, 0, 25);
+}
+
+VoxelGrid extractEndpointVoxels(const VoxelGrid& grid)
+{
+	return extractVoxelsByNeighbors(grid, 0, 1);
+}
+
+VoxelGrid extractJunctionVoxels(const VoxelGrid& grid)
+{
+	return extractVoxelsByNeighbors(grid, 3, 26);
+}
+
+long long countNumberVoxelsByNeighbors(const VoxelGrid& grid, int minimumNeighbors, int maximumNeighbors)
+{
+	// Number of voxels of each X slice, summed after the parallel loop
+	std::vector<long long> slices(grid.resolutionX(), 0);
+
+	forEachCounters(grid, [&](int index, int x, int y, std::uint64_t bits, const Counters& counters) {
+		slices[x] += countBits(bits & inRange(counters, minimumNeighbors + 1, maximumNeighbors + 1));
+	});
+
+	long long numberVoxels = 0;
+	for (const auto count : slices)
+	{
+		numberVoxels += count;
+	}
+
+	return numberVoxels;
+}
+
+std::vector<std::uint8_t> computeNumberNeighbors(const VoxelGrid& grid)
+{
+	// Slices are visited in the order of voxels, numbers of neighbors are concatenated after the parallel loop
+	std::vector<std::vector<std::uint8_t>> slices(grid.resolutionX());
+
+	forEachCounters(grid, [&](int index, int x, int y, std::uint64_t bits, const Counters& counters) {
+		while (bits != 0)
+		{
+			const auto bit = lowestBit(bits);
+			bits &= bits - 1;
+
+			int count = 0;
+			for (int i = 0; i < int(counters.size()); i++)
+			{
+				count |= int((counters[i] >> bit) & 1) << i;
+			}
+
+			// Do not count the voxel itself
+			slices[x].push_back(std::uint8_t(count - 1));
+		}
+	});
+
+	std::vector<std::uint8_t> numberNeighbors;
+	numberNeighbors.reserve(grid.numberVoxels());
+
+	for (const auto& slice : slices)
+	{
+		numberNeighbors.insert(numberNeighbors.end(), slice.begin(), slice.end());
+	}
+
+	return numberNeighbors;
+}
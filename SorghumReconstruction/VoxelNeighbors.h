@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "VoxelGrid.h"
+
+/**
+ * \brief Extract the voxels of a grid whose number of 26-connected neighbors is in a range.
+ *        Neighbors of 64 voxels are counted at a time with shifted words of bits and bit-sliced adders
+ * \param grid A voxel grid
+ * \param minimumNeighbors Minimum number of neighbors of the extracted voxels
+ * \param maximumNeighbors Maximum number of neighbors of the extracted voxels
+ * \return A voxel grid with the same resolution and storage, only with the extracted voxels
+ */
+VoxelGrid extractVoxelsByNeighbors(const VoxelGrid& grid, int minimumNeighbors, int maximumNeighbors);
+
+/**
+ * \brief Extract the voxels on the surface of a grid, with less than 26 neighbors
+ * \param grid A voxel grid
+ * \return A voxel grid with the surface voxels
+ */
+VoxelGrid extractSurfaceVoxels(const VoxelGrid& grid);
+
+/**
+ * \brief Extract the endpoints of a skeleton, voxels with at most 1 neighbor
+ * \param grid A voxel grid with a skeleton
+ * \return A voxel grid with the endpoints
+ */
+VoxelGrid extractEndpointVoxels(const VoxelGrid& grid);
+
+/**
+ * \brief Extract the junctions of a skeleton, voxels with at least 3 neighbors
+ * \param grid A voxel grid with a skeleton
+ * \return A voxel grid with the junctions
+ */
+VoxelGrid extractJunctionVoxels(const VoxelGrid& grid);
+
+/**
+ * \brief Count the voxels of a grid whose number of 26-connected neighbors is in a range
+ * \param grid A voxel grid
+ * \param minimumNeighbors Minimum number of neighbors of the counted voxels
+ * \param maximumNeighbors Maximum number of neighbors of the counted voxels
+ * \return The number of voxels
+ */
+long long countNumberVoxelsByNeighbors(const VoxelGrid& grid, int minimumNeighbors, int maximumNeighbors);
+
+/**
+ * \brief Compute the number of 26-connected neighbors of all voxels of a grid
+ * \param grid A voxel grid
+ * \return The number of neighbors of each voxel, in the order of grid.voxels()
+ */
+std::vector<std::uint8_t> computeNumberNeighbors(const VoxelGrid& grid);
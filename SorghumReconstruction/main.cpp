@@ -93,6 +93,21 @@ CommandLineParseResult parseCommandLine(
 		QCoreApplication::translate("main", "file"));
 	parser.addOption(outputOption);
 
+	// An option to cache projections between reconstructions of plants imaged with the same cameras
+	const QCommandLineOption projectionCacheOption(
+		QStringList() << "p" << "projection-cache",
+		QCoreApplication::translate("main", "Directory in which projections are cached for reconstruction, voxels are then carved by column intervals."),
+		QCoreApplication::translate("main", "directory"));
+	parser.addOption(projectionCacheOption);
+
+	// An option to store voxel grids sparsely, for resolutions whose dense grids do not fit in memory
+	const QCommandLineOption storageOption(
+		QStringList() << "s" << "storage",
+		QCoreApplication::translate("main", "Storage of voxel grids: dense (default), sparse"),
+		QCoreApplication::translate("main", "storage"),
+		"dense");
+	parser.addOption(storageOption);
+
 	// Process the actual command line arguments given by the user
 	parser.process(app);
 
@@ -108,6 +123,22 @@ CommandLineParseResult parseCommandLine(
 		parameters->commandType = readCommandTypeFromString(parser.value(commandOption).toStdString());
 		parameters->inputFile = parser.value(inputOption);
 		parameters->outputFile = parser.value(outputOption);
+		parameters->projectionCacheDirectory = parser.value(projectionCacheOption);
+
+		const auto storage = parser.value(storageOption);
+		if (storage == "dense")
+		{
+			parameters->storage = VoxelStorage::Dense;
+		}
+		else if (storage == "sparse")
+		{
+			parameters->storage = VoxelStorage::Sparse;
+		}
+		else
+		{
+			return CommandLineParseResult::Error;
+		}
+
 		return CommandLineParseResult::OkCmd;
 	}
 